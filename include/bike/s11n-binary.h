@@ -0,0 +1,217 @@
+// s11n
+//
+#pragma once
+
+#include "s11n-sbinary.h"
+#include "s11n-schema.h"
+#include <set>
+
+namespace bike {
+
+/// Binary format with tagged layout. Stream starts with format version, 
+/// then every serialized object is written as sized record. Record starts
+/// with names of fields, which are new in it, and schema fingerprint of object,
+/// when it's written in positional layout, or 0.
+class OutputBinarySerializer : public OutputBinarySerializerNode {
+public:
+	OutputBinarySerializer(std::ostream& out) 
+	: 	OutputBinarySerializerNode(S11N_NULLPTR, S11N_NULLPTR, &refs_, &tags_),
+		stream_(out),
+		fmtver_(3),
+		header_(false) {
+		writer_ = direct_ = &tags_.record();
+	}
+
+	~OutputBinarySerializer() {}
+
+	template <class T>
+	OutputBinarySerializer& operator << (T& t) {
+		write_record(t, 0);
+		return *this; 
+	}
+
+	/// Reader has the same schema for type with fingerprint, so it is written in positional layout
+	void accept(uint64_t fingerprint) {
+		if (fingerprint != 0)
+			accepted_.insert(fingerprint);
+	}
+
+	/// Writes object in positional layout, if its fingerprint is accepted, or in tagged one otherwise.
+	/// Types with pointers to polymorphic types have no fingerprint (0), because derived types
+	/// behind pointers aren't part of schema. They are always written in tagged layout
+	template <class T>
+	OutputBinarySerializer& fingerprinted(T& t) {
+		uint64_t fp = fingerprint<T>();
+		write_record(t, accepted_.count(fp) != 0? fp : 0);
+		return *this;
+	}
+
+	/// Forgets written objects except pinned ones, so references tables don't grow in long streams.
+	/// Written as empty record followed by previous ids of pinned objects
+	void end_session() {
+		write_header();
+		std::vector<unsigned> kept = refs_.reset();
+		EncoderImpl<UnsignedNumber>::encode(&stream_, 0);
+		EncoderImpl<UnsignedNumber>::encode(&stream_, kept.size());
+		for (size_t i = 0; i < kept.size(); ++i)
+			EncoderImpl<UnsignedNumber>::encode(&stream_, kept[i]);
+	}
+
+	unsigned format_version() {
+		return fmtver_;
+	}
+
+protected:
+	void write_header() {
+		if (!header_) {
+			EncoderImpl<UnsignedNumber>::encode(&stream_, fmtver_);
+			header_ = true;
+		}
+	}
+
+	template <class T>
+	void write_record(T& t, uint64_t fingerprint) {
+		write_header();
+		MemoryWriter& record = tags_.record();
+		EncoderImpl<UnsignedNumber>::encode(&record, fingerprint);
+		if (fingerprint != 0) {
+			OutputBinarySerializerNode::tags_ = S11N_NULLPTR;
+			*this & t;
+			OutputBinarySerializerNode::tags_ = &tags_;
+		}
+		else
+			*this & t;
+
+		MemoryWriter& names = tags_.definitions();
+		EncoderImpl<UnsignedNumber>::encode(&stream_, names.size() + record.size());
+		stream_.write(names.data(), names.size());
+		stream_.write(record.data(), record.size());
+		record.clear();
+	}
+
+protected:
+	OstreamWriter           stream_;
+	ReferencesPtr           refs_;
+	OutputBinaryTags        tags_;
+	unsigned                fmtver_;
+	bool                    header_;
+	std::set<uint64_t>      accepted_;
+};
+
+class InputBinarySerializer : public InputBinarySerializerNode {
+public:
+	InputBinarySerializer(std::istream& in)
+	: 	InputBinarySerializerNode(S11N_NULLPTR, S11N_NULLPTR, &refs_, &tags_),
+		stream_(in),
+		fmtver_(0),
+		failed_(false) {
+		reader_ = &tags_.record();
+	}
+
+	/// Object is left as is, if stream is ended or its record is corrupted
+	template <class T>
+	InputBinarySerializer& operator >> (T& t) {
+		uint64_t fp = 0;
+		if (!next_record(fp))
+			return *this;
+		S11N_ASSERT(fp == 0 && "Object in positional layout must be read with fingerprinted()!");
+		*this & t;
+		failed_ = tags_.record().failed();
+		return *this;
+	}
+
+	/// Reads object written with OutputBinarySerializer::fingerprinted. Record in positional
+	/// layout of other schema can't be decoded, so false is returned and t is left as is
+	template <class T>
+	bool fingerprinted(T& t) {
+		uint64_t fp = 0;
+		if (!next_record(fp) || (fp != 0 && fp != fingerprint<T>()))
+			return false;
+
+		if (fp != 0)
+			InputBinarySerializerNode::tags_ = S11N_NULLPTR;
+		*this & t;
+		InputBinarySerializerNode::tags_ = &tags_;
+		failed_ = tags_.record().failed();
+		return !failed_;
+	}
+
+	unsigned format_version() {
+		return fmtver_;
+	}
+
+	/// Stream is ended or record is corrupted. Objects aren't read after that
+	bool failed() const {
+		return failed_;
+	}
+
+protected:
+	/// Loads next record and reads fingerprint of its positional layout or 0.
+	/// False, if stream is ended or record is cut or has invalid names
+	bool next_record(uint64_t& fp) {
+		if (failed_)
+			return false;
+		if (fmtver_ == 0) {
+			UnsignedNumber fmtver;
+			DecoderImpl<UnsignedNumber>::decode(&stream_, fmtver);
+			fmtver_ = unsigned(fmtver);
+		}
+
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(&stream_, size);
+		for (; size == 0 && !stream_.failed(); DecoderImpl<UnsignedNumber>::decode(&stream_, size))
+			start_session();
+		failed_ = stream_.failed() || !tags_.record().load(&stream_, size_t(size));
+		if (!failed_ && fmtver_ >= 3)
+			failed_ = !tags_.read_definitions();
+
+		UnsignedNumber read_fp = 0;
+		if (!failed_ && fmtver_ >= 2)
+			DecoderImpl<UnsignedNumber>::decode(&tags_.record(), read_fp);
+		failed_ = failed_ || tags_.record().failed();
+		fp = read_fp;
+		return !failed_;
+	}
+
+	void start_session() {
+		UnsignedNumber count;
+		DecoderImpl<UnsignedNumber>::decode(&stream_, count);
+		std::vector<unsigned> kept;
+		for (uint64_t i = 0; i < count && !stream_.failed(); ++i) {
+			UnsignedNumber id;
+			DecoderImpl<UnsignedNumber>::decode(&stream_, id);
+			kept.push_back(unsigned(id));
+		}
+		refs_.reset(kept);
+	}
+
+protected:
+	IstreamReader   stream_;
+	ReferencesId    refs_;
+	InputBinaryTags tags_;
+	unsigned        fmtver_;
+	bool            failed_;
+};
+
+class BinarySerializer {
+public:
+	typedef InputBinarySerializer      Input;
+	typedef OutputBinarySerializer     Output;
+
+	typedef InputBinarySerializerNode  InNode;
+	typedef OutputBinarySerializerNode OutNode;
+
+	typedef BinarySerializerStorage    Storage;
+
+	template <class T>
+	static void input_call(T& t, InNode& node) {
+		InputBinarySerializerCall<T&>::call(t, node);
+	}
+
+	template <class T>
+	static void output_call(T& t, OutNode& node) {
+		OutputBinarySerializerCall<T&>::call(t, node);
+	}
+};
+
+} // namespace bike {
@@ -0,0 +1,419 @@
+// s11n
+//
+#pragma once
+
+#include "s11n-sbinary.h"
+
+#ifdef S11N_USE_LIST
+#include <list>
+namespace bike {
+template <class T>
+class OutputBinarySerializerCall<std::list<T>&> {
+public:
+	static void call(std::list<T>& t, OutputBinarySerializerNode& node) {
+		BinarySequence::write(t, node);
+	}
+};
+template <class T>
+class InputBinarySerializerCall<std::list<T>&> {
+public:
+	static void call(std::list<T>& t, InputBinarySerializerNode& node) {
+		BinarySequence::read(t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_LIST
+
+#ifndef S11N_CPP03
+
+#ifdef S11N_USE_MEMORY
+#include <memory>
+namespace bike {
+template <class T>
+class OutputBinarySerializerCall<std::unique_ptr<T>&> {
+public:
+	static void call(std::unique_ptr<T>& t, OutputBinarySerializerNode& node) {
+		node.ptr_impl(t.get());
+	}
+};
+template <class T>
+class InputBinarySerializerCall<std::unique_ptr<T>&> {
+public:
+	static void call(std::unique_ptr<T>& t, InputBinarySerializerNode& node) {
+		T* ref = S11N_NULLPTR;
+		node.ptr_impl(ref);
+		t.reset(ref);
+	}
+};
+
+template <class T>
+class OutputBinarySerializerCall<std::shared_ptr<T>&> {
+public:
+	static void call(std::shared_ptr<T>& t, OutputBinarySerializerNode& node) {
+		node.ptr_impl(t.get());
+	}
+};
+template <class T>
+class InputBinarySerializerCall<std::shared_ptr<T>&> {
+public:
+	static void call(std::shared_ptr<T>& t, InputBinarySerializerNode& node) {
+		T* ref = S11N_NULLPTR;
+		node.ptr_impl(ref);
+		if (ref == S11N_NULLPTR) {
+			t.reset();
+			return;
+		}
+
+		if (Unshared<T>::value) {
+			t.reset(ref);
+			return;
+		}
+
+		std::shared_ptr<void> owner = node.refs()->owner(ref);
+		if (owner)
+			t = std::shared_ptr<T>(owner, ref);
+		else {
+			t.reset(ref);
+			node.refs()->set_owner(ref, t);
+		}
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_MEMORY
+
+#ifdef S11N_USE_DEQUE
+#include <deque>
+namespace bike {
+template <class T>
+class OutputBinarySerializerCall<std::deque<T>&> {
+public:
+	static void call(std::deque<T>& t, OutputBinarySerializerNode& node) {
+		BinarySequence::write(t, node);
+	}
+};
+template <class T>
+class InputBinarySerializerCall<std::deque<T>&> {
+public:
+	static void call(std::deque<T>& t, InputBinarySerializerNode& node) {
+		BinarySequence::read(t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_DEQUE
+
+#ifdef S11N_USE_ARRAY
+#include <array>
+namespace bike {
+template <class T, size_t Size>
+class OutputBinarySerializerCall<std::array<T, Size>&> {
+public:
+	static void call(std::array<T, Size>& t, OutputBinarySerializerNode& node) {
+		BinaryArray::write(t.data(), Size, node);
+	}
+};
+template <class T, size_t Size>
+class InputBinarySerializerCall<std::array<T, Size>&> {
+public:
+	static void call(std::array<T, Size>& t, InputBinarySerializerNode& node) {
+		BinaryArray::read(t.data(), Size, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_ARRAY
+
+#if defined(S11N_USE_MAP) || defined(S11N_USE_SET) || defined(S11N_USE_UNORDERED_MAP)
+#include <utility>
+#include <tuple>
+#ifdef S11N_USE_UNORDERED_MAP
+#include <unordered_map>
+#endif
+namespace bike {
+/// Associative containers are filled with hint to the end, so sorted input of ordered
+/// containers is inserted without searching. Values are read in place.
+class BinaryAssociative {
+public:
+	template <class Cont>
+	static void write_set(Cont& container, OutputBinarySerializerNode& node) {
+		typedef typename Cont::value_type T;
+		UnsignedNumber size = container.size();
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), size);
+		typename Cont::iterator i = container.begin(), e = container.end();
+		for (; i != e; ++i)
+			OutputBinarySerializerCall<T&>::call(const_cast<T&>(*i), node);
+	}
+
+	template <class Cont>
+	static void read_set(Cont& container, InputBinarySerializerNode& node) {
+		typedef typename Cont::value_type T;
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), size);
+		container.clear();
+		reserve(container, size, node.reader());
+		for (uint64_t i = 0; i < size && !node.reader()->failed(); ++i) {
+			T t(Ctor<T, InputBinarySerializerNode>::ctor(node));
+			InputBinarySerializerCall<T&>::call(t, node);
+			container.emplace_hint(container.end(), std::move(t));
+		}
+	}
+
+	template <class Cont>
+	static void write_map(Cont& container, OutputBinarySerializerNode& node) {
+		typedef typename Cont::key_type    K;
+		typedef typename Cont::mapped_type V;
+		UnsignedNumber size = container.size();
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), size);
+		typename Cont::iterator i = container.begin(), e = container.end();
+		for (; i != e; ++i) {
+			OutputBinarySerializerCall<K&>::call(const_cast<K&>(i->first), node);
+			OutputBinarySerializerCall<V&>::call(i->second, node);
+		}
+	}
+
+	template <class Cont>
+	static void read_map(Cont& container, InputBinarySerializerNode& node) {
+		typedef typename Cont::key_type    K;
+		typedef typename Cont::mapped_type V;
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), size);
+		container.clear();
+		reserve(container, size, node.reader());
+		for (uint64_t i = 0; i < size && !node.reader()->failed(); ++i) {
+			K key(Ctor<K, InputBinarySerializerNode>::ctor(node));
+			InputBinarySerializerCall<K&>::call(key, node);
+			typename Cont::iterator placed = container.emplace_hint(container.end(),
+				std::piecewise_construct, 
+				std::forward_as_tuple(std::move(key)), 
+				std::forward_as_tuple(Ctor<V, InputBinarySerializerNode>::ctor(node)));
+			InputBinarySerializerCall<V&>::call(placed->second, node);
+		}
+	}
+
+protected:
+	template <class Cont>
+	static void reserve(Cont&, uint64_t, IReader*) {}
+
+#ifdef S11N_USE_UNORDERED_MAP
+	/// Bounded by data left, so corrupted size doesn't allocate too much
+	template <class K, class V, class H, class E, class A>
+	static void reserve(std::unordered_map<K, V, H, E, A>& container, uint64_t size, IReader* reader) {
+		container.reserve(size_t(std::min<uint64_t>(size, reader->left())));
+	}
+#endif
+};
+} // namespace bike {
+#endif
+
+#ifdef S11N_USE_MAP
+#include <map>
+namespace bike {
+template <class K, class V, class C, class A>
+class OutputBinarySerializerCall<std::map<K, V, C, A>&> {
+public:
+	static void call(std::map<K, V, C, A>& t, OutputBinarySerializerNode& node) {
+		BinaryAssociative::write_map(t, node);
+	}
+};
+template <class K, class V, class C, class A>
+class InputBinarySerializerCall<std::map<K, V, C, A>&> {
+public:
+	static void call(std::map<K, V, C, A>& t, InputBinarySerializerNode& node) {
+		BinaryAssociative::read_map(t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_MAP
+
+#ifdef S11N_USE_UNORDERED_MAP
+namespace bike {
+template <class K, class V, class H, class E, class A>
+class OutputBinarySerializerCall<std::unordered_map<K, V, H, E, A>&> {
+public:
+	static void call(std::unordered_map<K, V, H, E, A>& t, OutputBinarySerializerNode& node) {
+		BinaryAssociative::write_map(t, node);
+	}
+};
+template <class K, class V, class H, class E, class A>
+class InputBinarySerializerCall<std::unordered_map<K, V, H, E, A>&> {
+public:
+	static void call(std::unordered_map<K, V, H, E, A>& t, InputBinarySerializerNode& node) {
+		BinaryAssociative::read_map(t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_UNORDERED_MAP
+
+#ifdef S11N_USE_SET
+#include <set>
+namespace bike {
+template <class T, class C, class A>
+class OutputBinarySerializerCall<std::set<T, C, A>&> {
+public:
+	static void call(std::set<T, C, A>& t, OutputBinarySerializerNode& node) {
+		BinaryAssociative::write_set(t, node);
+	}
+};
+template <class T, class C, class A>
+class InputBinarySerializerCall<std::set<T, C, A>&> {
+public:
+	static void call(std::set<T, C, A>& t, InputBinarySerializerNode& node) {
+		BinaryAssociative::read_set(t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_SET
+
+#ifdef S11N_USE_UTILITY
+#include <utility>
+namespace bike {
+template <class T1, class T2>
+class OutputBinarySerializerCall<std::pair<T1, T2>&> {
+public:
+	static void call(std::pair<T1, T2>& t, OutputBinarySerializerNode& node) {
+		OutputBinarySerializerCall<T1&>::call(t.first, node);
+		OutputBinarySerializerCall<T2&>::call(t.second, node);
+	}
+};
+template <class T1, class T2>
+class InputBinarySerializerCall<std::pair<T1, T2>&> {
+public:
+	static void call(std::pair<T1, T2>& t, InputBinarySerializerNode& node) {
+		InputBinarySerializerCall<T1&>::call(t.first, node);
+		InputBinarySerializerCall<T2&>::call(t.second, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_UTILITY
+
+#ifdef S11N_USE_TUPLE
+#include <tuple>
+namespace bike {
+template <size_t I, size_t Size>
+class BinaryTuple {
+public:
+	template <class Tuple>
+	static void write(Tuple& t, OutputBinarySerializerNode& node) {
+		typedef typename std::tuple_element<I, Tuple>::type T;
+		OutputBinarySerializerCall<T&>::call(std::get<I>(t), node);
+		BinaryTuple<I + 1, Size>::write(t, node);
+	}
+
+	template <class Tuple>
+	static void read(Tuple& t, InputBinarySerializerNode& node) {
+		typedef typename std::tuple_element<I, Tuple>::type T;
+		InputBinarySerializerCall<T&>::call(std::get<I>(t), node);
+		BinaryTuple<I + 1, Size>::read(t, node);
+	}
+};
+
+template <size_t Size>
+class BinaryTuple<Size, Size> {
+public:
+	template <class Tuple>
+	static void write(Tuple&, OutputBinarySerializerNode&) {}
+
+	template <class Tuple>
+	static void read(Tuple&, InputBinarySerializerNode&) {}
+};
+
+template <class... Types>
+class OutputBinarySerializerCall<std::tuple<Types...>&> {
+public:
+	static void call(std::tuple<Types...>& t, OutputBinarySerializerNode& node) {
+		BinaryTuple<0, sizeof...(Types)>::write(t, node);
+	}
+};
+template <class... Types>
+class InputBinarySerializerCall<std::tuple<Types...>&> {
+public:
+	static void call(std::tuple<Types...>& t, InputBinarySerializerNode& node) {
+		BinaryTuple<0, sizeof...(Types)>::read(t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_TUPLE
+
+#ifdef S11N_CPP17
+
+#ifdef S11N_USE_OPTIONAL
+#include <optional>
+namespace bike {
+template <class T>
+class OutputBinarySerializerCall<std::optional<T>&> {
+public:
+	static void call(std::optional<T>& t, OutputBinarySerializerNode& node) {
+		EncoderImpl<bool>::encode(node.writer(), t.has_value());
+		if (t)
+			OutputBinarySerializerCall<T&>::call(*t, node);
+	}
+};
+template <class T>
+class InputBinarySerializerCall<std::optional<T>&> {
+public:
+	static void call(std::optional<T>& t, InputBinarySerializerNode& node) {
+		bool present = false;
+		DecoderImpl<bool>::decode(node.reader(), present);
+		if (!present) {
+			t.reset();
+			return;
+		}
+		t.emplace(Ctor<T, InputBinarySerializerNode>::ctor(node));
+		InputBinarySerializerCall<T&>::call(*t, node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_OPTIONAL
+
+#ifdef S11N_USE_VARIANT
+#include <variant>
+namespace bike {
+template <size_t I, size_t Size>
+class BinaryAlternative {
+public:
+	template <class Variant>
+	static void read(Variant& t, size_t index, InputBinarySerializerNode& node) {
+		if (index != I) {
+			BinaryAlternative<I + 1, Size>::read(t, index, node);
+			return;
+		}
+		typedef typename std::variant_alternative<I, Variant>::type T;
+		t.template emplace<I>(Ctor<T, InputBinarySerializerNode>::ctor(node));
+		InputBinarySerializerCall<T&>::call(std::get<I>(t), node);
+	}
+};
+
+template <size_t Size>
+class BinaryAlternative<Size, Size> {
+public:
+	template <class Variant>
+	static void read(Variant&, size_t, InputBinarySerializerNode&) {
+		S11N_ASSERT(0 && "Unknown alternative!");
+	}
+};
+
+template <class... Types>
+class OutputBinarySerializerCall<std::variant<Types...>&> {
+public:
+	static void call(std::variant<Types...>& t, OutputBinarySerializerNode& node) {
+		S11N_ASSERT(!t.valueless_by_exception());
+		UnsignedNumber index = t.index();
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), index);
+		std::visit([&node](auto& alt) {
+			OutputBinarySerializerCall<decltype(alt)>::call(alt, node);
+		}, t);
+	}
+};
+template <class... Types>
+class InputBinarySerializerCall<std::variant<Types...>&> {
+public:
+	static void call(std::variant<Types...>& t, InputBinarySerializerNode& node) {
+		UnsignedNumber index;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), index);
+		BinaryAlternative<0, sizeof...(Types)>::read(t, size_t(index), node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_VARIANT
+
+#endif // #ifdef S11N_CPP17
+
+#endif // #ifndef S11N_CPP03
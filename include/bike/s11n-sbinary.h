@@ -8,7 +8,11 @@
 #include <cstring>
 #include <cstdint>
 #include <cstdio>
-#include <iosfwd>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <istream>
+#include <ostream>
 
 namespace bike {
 
@@ -23,6 +27,12 @@ class IReader {
 public:
 	virtual size_t read(void* buf, size_t size) = 0;
 
+	/// Bytes left to read, maximal value if unknown
+	virtual size_t left() const { return size_t(-1); }
+
+	/// Some read got less bytes, than asked
+	virtual bool failed() const { return false; }
+
 	virtual ~IReader() {}
 };
 
@@ -81,16 +91,106 @@ protected:
 	FILE* fout_;
 };
 
+/// Keeps written data in memory
+class MemoryWriter : public IWriter
+{
+public:
+	MemoryWriter() {}
+
+	void write(const void* buf, size_t size) /* override */ {
+		buf_.append(reinterpret_cast<const char*>(buf), size);
+	}
+
+	/// Inserts data before already written one
+	void insert(size_t pos, const void* buf, size_t size) {
+		buf_.insert(pos, reinterpret_cast<const char*>(buf), size);
+	}
+
+	char& at(size_t pos) { return buf_[pos]; }
+
+	const char* data() const { return buf_.data(); }
+
+	size_t size() const { return buf_.size(); }
+
+	void clear() { buf_.clear(); }
+
+protected:
+	std::string buf_;
+};
+
+/// Reads data kept in memory with random access
+class MemoryReader : public IReader
+{
+public:
+	MemoryReader() : pos_(0), failed_(false) {}
+
+	/// Reading after end of data gives less bytes and fails reader
+	size_t read(void* buf, size_t size) /* override */ {
+		const size_t got = std::min(size, left());
+		if (got)
+			memcpy(buf, buf_.data() + pos_, got);
+		pos_ += got;
+		failed_ = failed_ || got < size;
+		return got;
+	}
+
+	/// Replaces kept data with next `size` bytes of reader. False, if reader has less
+	bool load(IReader* reader, size_t size) {
+		buf_.resize(size);
+		pos_    = 0;
+		failed_ = false;
+		if (size)
+			buf_.resize(reader->read(&buf_[0], size));
+		return buf_.size() == size;
+	}
+
+	bool failed() const /* override */ { return failed_; }
+
+	size_t left() const /* override */ {
+		return pos_ < buf_.size()? buf_.size() - pos_ : 0;
+	}
+
+	size_t pos() const { return pos_; }
+
+	void seek(size_t pos) { pos_ = pos; }
+
+	size_t size() const { return buf_.size(); }
+
+protected:
+	std::string buf_;
+	size_t      pos_;
+	bool        failed_;
+};
+
 class OstreamWriter : public IWriter
 {
 public:
-	OstreamWriter(const char* filename);
+	OstreamWriter(std::ostream& out)
+	:	out_(&out) {}
 
-	~OstreamWriter();
+	void write(const void* buf, size_t size) /* override */ {
+		out_->write(reinterpret_cast<const char*>(buf), size);
+	}
 
-	void write(void* buf, size_t size) /* override */;
 protected:
-	std::ostream* fout_;
+	std::ostream* out_;
+};
+
+class IstreamReader : public IReader
+{
+public:
+	IstreamReader(std::istream& in)
+	:	in_(&in) {}
+
+	size_t read(void* buf, size_t size) /* override */ {
+		in_->read(reinterpret_cast<char*>(buf), size);
+		return size_t(in_->gcount());
+	}
+
+	bool failed() const /* override */ { return in_->fail(); }
+
+protected:
+	std::istream* in_;
 };
 
 struct UnsignedNumber {
@@ -259,6 +359,51 @@ ENC_RAW(uint64_t);
 
 #undef ENC_RAW
 
+/// Types without own conversion are encoded as integer with the same size
+#define ENC_AS(Type, As)\
+	template <>\
+	class EncoderImpl<Type> {\
+	public:\
+		static void encode(IWriter* writer, const Type& v) {\
+			As tmp;\
+			memcpy(&tmp, &v, sizeof(As));\
+			EncoderImpl<As>::encode(writer, tmp);\
+		}\
+	}; \
+	template <>\
+	class DecoderImpl<Type> {\
+	public:\
+		static void decode(IReader* reader, Type& v) {\
+			As tmp;\
+			DecoderImpl<As>::decode(reader, tmp);\
+			memcpy(&v, &tmp, sizeof(As));\
+		}\
+	};
+
+ENC_AS(char,   int8_t);
+ENC_AS(float,  uint32_t);
+ENC_AS(double, uint64_t);
+
+#undef ENC_AS
+
+template <>
+class EncoderImpl<bool> {
+public:
+	static void encode(IWriter* writer, const bool& v) {
+		uint8_t tmp = v? 1 : 0;
+		writer->write(&tmp, 1);
+	}
+};
+template <>
+class DecoderImpl<bool> {
+public:
+	static void decode(IReader* reader, bool& v) {
+		uint8_t tmp = 0;
+		reader->read(&tmp, 1);
+		v = tmp != 0;
+	}
+};
+
 #undef CONCATIMPL
 #undef CONCAT
 #undef CONV_NAME
@@ -308,7 +453,7 @@ public:
 		int enc_ofs = ((msb + 6) / 7) * 7;
 		do {
 			enc_ofs -= 7;
-			uint32_t flmask = VALUE_MASK << enc_ofs;
+			uint64_t flmask = uint64_t(VALUE_MASK) << enc_ofs;
 			uint8_t w = uint8_t((v & flmask) >> enc_ofs);
 			if (enc_ofs > 0)
 				w |= NEXT_MASK;
@@ -319,14 +464,17 @@ public:
 template <>
 class DecoderImpl<UnsignedNumber> : public UnsignedNumberEncoding {
 public:
+	/// Number cut by end of data is 0
 	static void decode(IReader* reader, UnsignedNumber& v) {
 		bool next = true;
 		v = 0;
 		do {
-			uint8_t r;
-			reader->read(&r, 1);
+			uint8_t r = 0;
+			if (reader->read(&r, 1) != 1) {
+				v = 0;
+				return;
+			}
 			next = (r & NEXT_MASK) > 0;
-			uint8_t m = r & VALUE_MASK;
 			v <<= 7;
 			v |= r & VALUE_MASK;
 		} while (next);
@@ -353,9 +501,12 @@ public:
 		v.clear();
 		UnsignedNumber size;
 		DecoderImpl<UnsignedNumber>::decode(reader, size);
+		// Corrupted size is cut to data left and one byte more, so reader fails without large allocation
+		if (size > reader->left())
+			size = uint64_t(reader->left()) + 1;
 		if (size) {
 			v.resize(size_t(size));
-			reader->read(&v[0], (size_t) size);
+			v.resize(reader->read(&v[0], (size_t) size));
 		}
 	}
 };
@@ -381,8 +532,8 @@ public:
 		v.clear();
 		UnsignedNumber size;
 		DecoderImpl<UnsignedNumber>::decode(reader, size);
-		v.reserve(size_t(size));
-		for (size_t i = 0; i < size; ++i) {
+		v.reserve(size_t(std::min<uint64_t>(size, reader->left())));
+		for (size_t i = 0; i < size && !reader->failed(); ++i) {
 			T tmp;
 			DecoderImpl<T>::decode(reader, tmp);
 			v.push_back(tmp);
@@ -390,45 +541,562 @@ public:
 	}
 };
 
+class BinarySerializerStorage {
+	S11N_TYPE_STORAGE
+};
+
+/// Keys of fields in tagged layout
+class BinaryTagsEncoding {
+public:
+	const static unsigned END_KEY     = 0; /// Marks end of object fields
+	const static unsigned UNNAMED_ID  = 1;
+	const static unsigned FIRST_ID    = 2;
+	const static unsigned DEFINE_FLAG = 1; /// Key is followed by name of new id. Format version 2 only
+};
+
+/// Tagged layout of binary format. Every field is prefixed with interned name 
+/// and payload size, so fields can be searched and skipped.
+/// Record is kept in memory until it's complete to fill sizes. Names, which are
+/// new in record, are written before it, so reader knows them before any field.
+class OutputBinaryTags : public BinaryTagsEncoding {
+public:
+	typedef std::map<std::string, unsigned> NameMap;
+
+	OutputBinaryTags() : id_(FIRST_ID) {}
+
+	MemoryWriter& record() { return record_; }
+
+	/// Names defined by current record: their number, first id and names. Clears them
+	MemoryWriter& definitions() {
+		definitions_.clear();
+		EncoderImpl<UnsignedNumber>::encode(&definitions_, defined_.size());
+		if (!defined_.empty()) {
+			EncoderImpl<UnsignedNumber>::encode(&definitions_, id_ - defined_.size());
+			for (size_t i = 0; i < defined_.size(); ++i)
+				EncoderImpl<std::string>::encode(&definitions_, *defined_[i]);
+			defined_.clear();
+		}
+		return definitions_;
+	}
+
+	/// Writes field key and reserves one byte for payload size
+	size_t begin_field(const char* name) {
+		unsigned id = UNNAMED_ID;
+		if (name && name[0] != '\0') {
+			// Names may be built in buffers, which are reused, so they are found by content.
+			// Key buffer keeps its capacity, so lookup doesn't allocate
+			key_.assign(name);
+			NameMap::const_iterator found = names_.find(key_);
+			if (found == names_.end()) {
+				id = id_++;
+				found = names_.insert(std::make_pair(key_, id)).first;
+				defined_.push_back(&found->first);
+			}
+			else
+				id = found->second;
+		}
+
+		EncoderImpl<UnsignedNumber>::encode(&record_, uint64_t(id) << 1);
+		uint8_t size = 0;
+		record_.write(&size, 1);
+		return record_.size() - 1;
+	}
+
+	/// Fills payload size of field
+	void end_field(size_t at) {
+		UnsignedNumber size = record_.size() - at - 1;
+		if (size <= UnsignedNumberEncoding::VALUE_MASK) {
+			record_.at(at) = char(size);
+			return;
+		}
+		// Rare case of long payload. Moving it to make place for size
+		MemoryWriter enc;
+		EncoderImpl<UnsignedNumber>::encode(&enc, size);
+		record_.at(at) = enc.data()[0];
+		record_.insert(at + 1, enc.data() + 1, enc.size() - 1);
+	}
+
+	void end_object() {
+		uint8_t end = END_KEY;
+		record_.write(&end, 1);
+	}
+
+protected:
+	MemoryWriter record_;
+	MemoryWriter definitions_;
+	NameMap      names_;
+	std::vector<const std::string*> defined_;
+	std::string  key_;
+	unsigned     id_;
+};
+
+class InputBinaryTags : public BinaryTagsEncoding {
+public:
+	InputBinaryTags() {
+		names_.resize(FIRST_ID);
+	}
+
+	MemoryReader& record() { return record_; }
+
+	/// Reads names defined by record. Ids follow known ones, so false is returned for others
+	bool read_definitions() {
+		UnsignedNumber count;
+		DecoderImpl<UnsignedNumber>::decode(&record_, count);
+		if (count == 0)
+			return true;
+		UnsignedNumber first;
+		DecoderImpl<UnsignedNumber>::decode(&record_, first);
+		if (uint64_t(first) != names_.size())
+			return false;
+		for (uint64_t i = 0; i < count && !record_.failed(); ++i) {
+			names_.push_back(std::string());
+			DecoderImpl<std::string>::decode(&record_, names_.back());
+		}
+		return !record_.failed();
+	}
+
+	/// Reads field key. Returns false in the end of object
+	bool read_key(unsigned& id) {
+		UnsignedNumber key;
+		DecoderImpl<UnsignedNumber>::decode(&record_, key);
+		if (key == END_KEY)
+			return false;
+
+		id = unsigned(key >> 1);
+		if (key & DEFINE_FLAG) {
+			std::string name;
+			DecoderImpl<std::string>::decode(&record_, name);
+			if (names_.size() <= id)
+				names_.resize(id + 1);
+			names_[id] = name;
+		}
+		return true;
+	}
+
+	/// Reads field key and size. Returns false in the end of object
+	bool read_field(unsigned& id, size_t& end) {
+		if (!read_key(id))
+			return false;
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(&record_, size);
+		end = record_.pos() + size_t(size);
+		return true;
+	}
+
+	bool is(unsigned id, const char* name) const {
+		return id < names_.size() && names_[id] == name;
+	}
+
+protected:
+	MemoryReader             record_;
+	std::vector<std::string> names_;
+};
+
+/// Node of binary format. Writes fields one by one (positional layout)
+/// or with keys and sizes (tagged layout), when tags are set.
 class OutputBinarySerializerNode {
 public:
-	OutputBinarySerializerNode(IWriter* writer)
-	:	writer_(writer) {}
+	OutputBinarySerializerNode(OutputBinarySerializerNode* parent, IWriter* writer, ReferencesPtr* refs, OutputBinaryTags* tags)
+	:	parent_(parent),
+		writer_(writer),
+		direct_(writer),
+		refs_(refs),
+		tags_(tags),
+		version_(0),
+		started_(parent == S11N_NULLPTR),
+		optionals_(0),
+		memory_(S11N_NULLPTR),
+		presence_at_(0) {}
+
+	/// Version must be declared before fields
+	void decl_version(unsigned ver) {
+		S11N_ASSERT(!started_ && "Declare version before fields!");
+		version_ = ver;
+	}
+
+	unsigned version() const {
+		return version_;
+	}
+
+	template <class Base>
+	OutputBinarySerializerNode& base(Base* base_ptr) {
+		Base* base = static_cast<Base*>(base_ptr);
+		if (typeid(*base_ptr) != typeid(Base))
+			S11N_ASSERT(TypeStorageAccessor<BinarySerializerStorage>::find(typeid(*base_ptr)) != 0 && "Can't serialize type!");
+		return *this & (*base);
+	}
 
 	template <class T>
 	OutputBinarySerializerNode& operator & (T& t) {
-		OutputBinarySerializerCall<T&>::call(t, *this);
+		return named(t, "");
+	}
+
+	template <class T>
+	OutputBinarySerializerNode& named(T& t, const char* name) {
+		start();
+		if (tags_ != S11N_NULLPTR) {
+			size_t at = tags_->begin_field(name);
+			OutputBinarySerializerCall<T&>::call(t, *this);
+			tags_->end_field(at);
+		}
+		else
+			OutputBinarySerializerCall<T&>::call(t, *this);
 		return *this;
 	}
 
+	/// Optional field is omitted in tagged layout and costs one bit in object 
+	/// presence bitmap in positional one. Bitmap is written before first optional 
+	/// field. Memory writer gets it inserted in place by `finish`, fields for other
+	/// writers are delayed until then.
+	template <class T>
+	void optional(T& t, const char* name, const T& def) {
+		S11N_ASSERT(name && name[0] != '\0');
+		start();
+		if (tags_ != S11N_NULLPTR) {
+			if (t != def)
+				named(t, name);
+			return;
+		}
+
+		if (optionals_ == 0) {
+			memory_ = dynamic_cast<MemoryWriter*>(direct_);
+			if (memory_ != S11N_NULLPTR)
+				presence_at_ = memory_->size();
+			else
+				writer_ = &delayed_;
+		}
+
+		if (optionals_ % 8 == 0)
+			presence_.push_back(0);
+
+		if (t != def) {
+			presence_.back() |= uint8_t(1 << (optionals_ % 8));
+			*this & t;
+		}
+		++optionals_;
+	}
+
+	template <class T>
+	void ptr_impl(T* t) {
+		S11N_ASSERT(refs_);
+		UnsignedNumber ref = 0;
+		bool inserted = false;
+		if (t != S11N_NULLPTR) {
+			std::pair<bool, unsigned> set_result = Unshared<T>::value?
+				std::make_pair(true, refs_->next()) : refs_->set(t);
+			inserted = set_result.first;
+			ref      = set_result.second;
+		}
+		EncoderImpl<UnsignedNumber>::encode(writer_, ref);
+
+		if (inserted) {
+			static S11N_THREAD_LOCAL TypeCache cache;
+			const Type* type = TypeStorageAccessor<BinarySerializerStorage>::find(typeid(*t), cache);
+			// Registered types are written with key to construct them later
+			UnsignedNumber type_id = type? type->key : 0;
+			EncoderImpl<UnsignedNumber>::encode(writer_, type_id);
+			if (type) {
+				PtrHolder node(this);
+				type->ctor->write(t, node);
+			}
+			else
+				OutputBinarySerializerCall<T&>::call(*t, *this);
+		}
+	}
+
+	/// Completes object: writes end of fields or presence bitmap and delayed fields
+	void finish() {
+		start();
+		if (tags_ != S11N_NULLPTR) {
+			tags_->end_object();
+			return;
+		}
+
+		if (optionals_ == 0)
+			return;
+
+		if (memory_ != S11N_NULLPTR) {
+			// Nested objects write to the same memory, so payload is moved once, not copied per level
+			EncoderImpl<UnsignedNumber>::encode(&delayed_, optionals_);
+			delayed_.write(&presence_[0], presence_.size());
+			memory_->insert(presence_at_, delayed_.data(), delayed_.size());
+		}
+		else {
+			EncoderImpl<UnsignedNumber>::encode(direct_, optionals_);
+			direct_->write(&presence_[0], presence_.size());
+			if (delayed_.size())
+				direct_->write(delayed_.data(), delayed_.size());
+		}
+
+		writer_    = direct_;
+		optionals_ = 0;
+		memory_    = S11N_NULLPTR;
+		presence_.clear();
+		delayed_.clear();
+	}
+
 	IWriter* writer() { return writer_; }
 
+	ReferencesPtr* refs() const { return refs_; }
+
+	OutputBinaryTags* tags() const { return tags_; }
+
+	OutputEssence essence() { return OutputEssence(); }
+
+protected:
+	/// Object version is written before its first field
+	void start() {
+		if (started_)
+			return;
+		started_ = true;
+		if (tags_ != S11N_NULLPTR)
+			EncoderImpl<UnsignedNumber>::encode(writer_, version_);
+	}
+
 protected:
-	IWriter* writer_;
+	OutputBinarySerializerNode* parent_;
+
+	IWriter*          writer_;
+	IWriter*          direct_;
+	ReferencesPtr*    refs_;
+	OutputBinaryTags* tags_;
+	unsigned          version_;
+	bool              started_;
+
+	unsigned             optionals_;
+	std::vector<uint8_t> presence_;
+	MemoryWriter         delayed_;     /// Fields after bitmap for other writers than memory one
+	MemoryWriter*        memory_;      /// Writer, which gets bitmap inserted in place
+	size_t               presence_at_; /// Place of bitmap in memory writer
 };
 
 class InputBinarySerializerNode {
 public:
-	InputBinarySerializerNode(IReader* reader)
-	:	reader_(reader) {}
+	InputBinarySerializerNode(InputBinarySerializerNode* parent, IReader* reader, ReferencesId* refs, InputBinaryTags* tags)
+	:	parent_(parent),
+		reader_(reader),
+		refs_(refs),
+		tags_(tags),
+		version_(0),
+		begin_(0),
+		optionals_(0) {}
+
+	/// Positional layout doesn't keep versions, so reader and writer versions are the same
+	void decl_version(unsigned ver) {
+		if (tags_ == S11N_NULLPTR)
+			version_ = ver;
+	}
+
+	unsigned version() const {
+		return version_;
+	}
+
+	template <class Base>
+	InputBinarySerializerNode& base(Base* base) {
+		return *this & (*base);
+	}
 
 	template <class T>
 	InputBinarySerializerNode& operator & (T& t) {
-		InputBinarySerializerCall<T&>::call(t, *this);
+		return named(t, "");
+	}
+
+	template <class T>
+	InputBinarySerializerNode& named(T& t, const char* name) {
+		if (tags_ == S11N_NULLPTR) {
+			InputBinarySerializerCall<T&>::call(t, *this);
+			return *this;
+		}
+
+		// Writer has less fields or hasn't this one. Leave value as is
+		read_field(t, name);
 		return *this;
 	}
 
+	template <class T>
+	void optional(T& t, const char* name, const T& def) {
+		S11N_ASSERT(name && name[0] != '\0');
+		if (tags_ != S11N_NULLPTR) {
+			if (!read_field(t, name))
+				t = def;
+			return;
+		}
+
+		if (optionals_ == 0)
+			read_presence();
+
+		if (present(optionals_++))
+			*this & t;
+		else
+			t = def;
+	}
+
+	/// Searches field of object, which is next in stream. Needs tagged layout.
+	template <class T>
+	bool search(T& t, const char* name) {
+		S11N_ASSERT(tags_ && "Search needs tagged layout!");
+		if (tags_ == S11N_NULLPTR)
+			return false;
+
+		MemoryReader& record = tags_->record();
+		size_t from = record.pos();
+
+		UnsignedNumber ver;
+		DecoderImpl<UnsignedNumber>::decode(&record, ver);
+
+		bool found = false;
+		unsigned id = 0;
+		size_t  end = 0;
+		while (!found && tags_->read_field(id, end)) {
+			if (tags_->is(id, name)) {
+				InputBinarySerializerCall<T&>::call(t, *this);
+				found = true;
+			}
+			record.seek(end);
+		}
+
+		record.seek(from);
+		S11N_ASSERT(found);
+		return found;
+	}
+
+	template <class T>
+	void ptr_impl(T*& t) {
+		S11N_ASSERT(refs_);
+		UnsignedNumber ref;
+		DecoderImpl<UnsignedNumber>::decode(reader_, ref);
+		if (ref == 0 || !refs_->accept(ref)) {
+			S11N_ASSERT(ref == 0 && "Invalid reference!");
+			t = S11N_NULLPTR;
+			return;
+		}
+
+		void* ptr = Unshared<T>::value? S11N_NULLPTR : refs_->get(unsigned(ref));
+		if (ptr != S11N_NULLPTR) {
+			t = static_cast<T*>(ptr);
+			return;
+		}
+
+		UnsignedNumber type_id;
+		DecoderImpl<UnsignedNumber>::decode(reader_, type_id);
+		static S11N_THREAD_LOCAL TypeCache cache;
+		const Type* type = TypeStorageAccessor<BinarySerializerStorage>::find_key(unsigned(type_id), cache);
+
+		if (type != S11N_NULLPTR) {
+			PtrHolder node_holder(this);
+			PtrHolder got = type->ctor->create(node_holder);
+			t = got.get<T>();
+			if (!Unshared<T>::value)
+				refs_->set(unsigned(ref), t);
+			type->ctor->read(t, node_holder);
+		}
+		else {
+			t = Ctor<T*, InputBinarySerializerNode>::ctor(*this);
+			if (!Unshared<T>::value)
+				refs_->set(unsigned(ref), t);
+			InputBinarySerializerCall<T&>::call(*t, *this);
+		}
+	}
+
+	/// Reads object version in tagged layout
+	void start() {
+		if (tags_ == S11N_NULLPTR)
+			return;
+		UnsignedNumber ver;
+		DecoderImpl<UnsignedNumber>::decode(reader_, ver);
+		version_ = unsigned(ver);
+		begin_   = tags_->record().pos();
+	}
+
+	/// Skips fields unknown for reader in tagged layout
+	void finish() {
+		if (tags_ == S11N_NULLPTR)
+			return;
+		unsigned id = 0;
+		size_t  end = 0;
+		while (tags_->read_field(id, end))
+			tags_->record().seek(end);
+	}
+
 	IReader* reader() { return reader_; }
 
+	ReferencesId* refs() const { return refs_; }
+
+	InputBinaryTags* tags() const { return tags_; }
+
+	InputEssence essence() { return InputEssence(); }
+
+protected:
+	/// Reads field in tagged layout. Unnamed fields are read in order. Named field is
+	/// checked to be the next one, otherwise it's searched in fields of object, so writer
+	/// may have other order of fields. Returns false, if writer has no such field
+	template <class T>
+	bool read_field(T& t, const char* name) {
+		MemoryReader& record = tags_->record();
+		const size_t at = record.pos();
+		unsigned id  = 0;
+		size_t   end = 0;
+		const bool unnamed = name == S11N_NULLPTR || name[0] == '\0';
+		if (tags_->read_field(id, end) && (unnamed || tags_->is(id, name))) {
+			InputBinarySerializerCall<T&>::call(t, *this);
+			record.seek(end);
+			return true;
+		}
+
+		if (!unnamed) {
+			record.seek(begin_);
+			while (tags_->read_field(id, end)) {
+				if (tags_->is(id, name)) {
+					InputBinarySerializerCall<T&>::call(t, *this);
+					record.seek(at);
+					return true;
+				}
+				record.seek(end);
+			}
+		}
+		record.seek(at);
+		return false;
+	}
+
+	void read_presence() {
+		UnsignedNumber count;
+		DecoderImpl<UnsignedNumber>::decode(reader_, count);
+		presence_.resize(size_t((count + 7) / 8));
+		if (!presence_.empty())
+			reader_->read(&presence_[0], presence_.size());
+	}
+
+	bool present(unsigned index) const {
+		// Fields unknown to writer are absent
+		if (index / 8 >= presence_.size())
+			return false;
+		return (presence_[index / 8] & (1 << (index % 8))) != 0;
+	}
+
 protected:
-	IReader* reader_;
+	InputBinarySerializerNode* parent_;
+
+	IReader*         reader_;
+	ReferencesId*    refs_;
+	InputBinaryTags* tags_;
+	unsigned         version_;
+	size_t           begin_;   /// First field of object in tagged layout
+
+	unsigned             optionals_;
+	std::vector<uint8_t> presence_;
 };
 
 template <class T>
 class InputBinarySerializerCall {
 public:
 	static void call(T& t, InputBinarySerializerNode& node) {
-		t.ser(node);
+		InputBinarySerializerNode sub(&node, node.reader(), node.refs(), node.tags());
+		sub.start();
+		/*
+		 * Please implement `ser` method in your class.
+		 */
+		t.ser(sub);
+		sub.finish();
 	}
 };
 
@@ -436,7 +1104,28 @@ template <class T>
 class OutputBinarySerializerCall {
 public:
 	static void call(T& t, OutputBinarySerializerNode& node) {
-		t.ser(node);
+		OutputBinarySerializerNode sub(&node, node.writer(), node.refs(), node.tags());
+		/*
+		 * Please implement `ser` method in your class.
+		 */
+		t.ser(sub);
+		sub.finish();
+	}
+};
+
+template <class T>
+class OutputBinarySerializerCall<T*&> {
+public:
+	static void call(T*& t, OutputBinarySerializerNode& node) {
+		node.ptr_impl(t);
+	}
+};
+
+template <class T>
+class InputBinarySerializerCall<T*&> {
+public:
+	static void call(T*& t, InputBinarySerializerNode& node) {
+		node.ptr_impl(t);
 	}
 };
 
@@ -457,6 +1146,7 @@ public:
 	}; 
 
 SN_RAW(bool);
+SN_RAW(char);
 SN_RAW(int8_t);
 SN_RAW(uint8_t);
 SN_RAW(int16_t);
@@ -466,50 +1156,256 @@ SN_RAW(uint32_t);
 SN_RAW(int64_t);
 SN_RAW(uint64_t);
 
+SN_RAW(float);
+SN_RAW(double);
+
 SN_RAW(std::string);
 
 #undef SN_RAW
 
+template <int Size>
+class OutputBinarySerializerCall<char(&)[Size]> {
+public:
+	static void call(char(&t)[Size], OutputBinarySerializerNode& node) {
+		UnsignedNumber size = strlen(t);
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), size);
+		node.writer()->write(t, (size_t) size);
+	}
+};
+template <int Size>
+class InputBinarySerializerCall<char(&)[Size]> {
+public:
+	static void call(char(&t)[Size], InputBinarySerializerNode& node) {
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), size);
+		S11N_ASSERT(size < Size);
+		node.reader()->read(t, (size_t) size);
+		t[size_t(size)] = '\0';
+	}
+};
+
+/// Arithmetic types are kept in memory the same way as in format on little-endian 
+/// machines, so their arrays are copied at once
+template <class T>
+struct BinaryPacked { enum { value = 0 }; };
+
+#define SN_PACKED(Type)\
+	template <>\
+	struct BinaryPacked<Type> { enum { value = 1 }; };
+
+SN_PACKED(char);
+SN_PACKED(int8_t);
+SN_PACKED(uint8_t);
+SN_PACKED(int16_t);
+SN_PACKED(uint16_t);
+SN_PACKED(int32_t);
+SN_PACKED(uint32_t);
+SN_PACKED(int64_t);
+SN_PACKED(uint64_t);
+SN_PACKED(float);
+SN_PACKED(double);
+
+#undef SN_PACKED
+
+class BinaryArray {
+public:
+	template <class T>
+	static void write(T* data, size_t size, OutputBinarySerializerNode& node) {
+		if (BinaryPacked<T>::value && IsLittleEndian) {
+			if (size)
+				node.writer()->write(data, size * sizeof(T));
+			return;
+		}
+		for (size_t i = 0; i < size; ++i)
+			OutputBinarySerializerCall<T&>::call(data[i], node);
+	}
+
+	/// Reads into constructed elements
+	template <class T>
+	static void read(T* data, size_t size, InputBinarySerializerNode& node) {
+		if (BinaryPacked<T>::value && IsLittleEndian) {
+			if (size)
+				node.reader()->read(data, size * sizeof(T));
+			return;
+		}
+		for (size_t i = 0; i < size; ++i)
+			InputBinarySerializerCall<T&>::call(data[i], node);
+	}
+};
+
+class BinarySequence {
+public:
+	template <class Cont>
+	static void read(Cont& container, InputBinarySerializerNode& node) {
+		read<Cont, typename Cont::value_type>(container, node);
+	}
+
+	template <class Cont, class T>
+	static void read(Cont& container, InputBinarySerializerNode& node) {
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), size);
+		container.clear();
+		reserve(container, size, node.reader());
+		for (uint64_t i = 0; i < size && !node.reader()->failed(); ++i) {
+			container.push_back(Ctor<T, InputBinarySerializerNode>::ctor(node));
+			InputBinarySerializerCall<T&>::call(container.back(), node);
+		}
+	}
+
+	/// Elements of vector<bool> are proxies, so they are read to local value and then added
+	static void read(std::vector<bool>& container, InputBinarySerializerNode& node) {
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), size);
+		container.clear();
+		reserve(container, size, node.reader());
+		for (uint64_t i = 0; i < size && !node.reader()->failed(); ++i) {
+			bool value = false;
+			InputBinarySerializerCall<bool&>::call(value, node);
+			container.push_back(value);
+		}
+	}
+
+	template <class Cont>
+	static void write(Cont& container, OutputBinarySerializerNode& node) {
+		UnsignedNumber size = container.size();
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), size);
+		BinarySequence::write(container.begin(), container.end(), node);
+	}
+
+	static void write(std::vector<bool>& container, OutputBinarySerializerNode& node) {
+		UnsignedNumber size = container.size();
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), size);
+		for (size_t i = 0; i < container.size(); ++i) {
+			bool value = container[i];
+			OutputBinarySerializerCall<bool&>::call(value, node);
+		}
+	}
+
+	template <class FwdIter>
+	static void write(FwdIter begin, FwdIter end, OutputBinarySerializerNode& node) {
+		for (; begin != end; ++begin)
+			OutputBinarySerializerCall<typename std::iterator_traits<FwdIter>::value_type&>::call(*begin, node);
+	}
+
+protected:
+	template <class Cont>
+	static void reserve(Cont&, uint64_t, IReader*) {}
+
+	/// Each element takes at least one byte, so corrupted size can't allocate more than data
+	template <class T>
+	static void reserve(std::vector<T>& container, uint64_t size, IReader* reader) {
+		container.reserve(size_t(std::min<uint64_t>(size, reader->left())));
+	}
+};
+
 //
 // std::vector
 //
+template <bool Packed>
+class BinaryVector {
+public:
+	template <class T>
+	static void write(std::vector<T>& t, OutputBinarySerializerNode& node) {
+		BinarySequence::write(t, node);
+	}
+
+	template <class T>
+	static void read(std::vector<T>& t, InputBinarySerializerNode& node) {
+		BinarySequence::read(t, node);
+	}
+};
+
+template <>
+class BinaryVector<true> {
+public:
+	template <class T>
+	static void write(std::vector<T>& t, OutputBinarySerializerNode& node) {
+		UnsignedNumber size = t.size();
+		EncoderImpl<UnsignedNumber>::encode(node.writer(), size);
+		if (size)
+			BinaryArray::write(&t[0], t.size(), node);
+	}
+
+	template <class T>
+	static void read(std::vector<T>& t, InputBinarySerializerNode& node) {
+		UnsignedNumber size;
+		DecoderImpl<UnsignedNumber>::decode(node.reader(), size);
+		// Corrupted size is larger than data
+		if (size > node.reader()->left() / sizeof(T)) {
+			t.clear();
+			return;
+		}
+		t.resize(size_t(size));
+		if (size)
+			BinaryArray::read(&t[0], t.size(), node);
+	}
+};
+
 template <class T>
 class OutputBinarySerializerCall<std::vector<T>&> {
 public:
 	static void call(std::vector<T>& t, OutputBinarySerializerNode& node) {
-		EncoderImpl< std::vector<T> >::encode(node.writer(), t);
+		BinaryVector<BinaryPacked<T>::value != 0>::write(t, node);
 	}
 };
 template <class T>
 class InputBinarySerializerCall<std::vector<T>&> {
 public:
 	static void call(std::vector<T>& t, InputBinarySerializerNode& node) {
-		DecoderImpl< std::vector<T> >::decode(node.reader(), t);
+		BinaryVector<BinaryPacked<T>::value != 0>::read(t, node);
 	}
 }; 
 
+#define S11N_BINARY_OUT(Type, Function)\
+	template <>\
+	class OutputBinarySerializerCall<Type&> {\
+	public:\
+		static void call(Type& t, OutputBinarySerializerNode& node) {\
+			OutputBinarySerializerNode sub(&node, node.writer(), node.refs(), node.tags());\
+			Function(t, sub);\
+			sub.finish();\
+		}\
+	};\
+	template <>\
+	class InputBinarySerializerCall<Type&> {\
+	public:\
+		static void call(Type& t, InputBinarySerializerNode& node) {\
+			InputBinarySerializerNode sub(&node, node.reader(), node.refs(), node.tags());\
+			sub.start();\
+			Function(t, sub);\
+			sub.finish();\
+		}\
+	};
+
+/// Lightweight positional streaming
 class OutputBinaryStreaming : public OutputBinarySerializerNode {
 public:
 	OutputBinaryStreaming(IWriter* writer)
-	:	OutputBinarySerializerNode(writer) {}
+	:	OutputBinarySerializerNode(S11N_NULLPTR, writer, &refs_, S11N_NULLPTR) {}
 
 	template <class T>
 	OutputBinaryStreaming& operator << (T& t) {
 		(*((OutputBinarySerializerNode*) this)) & t;
 		return *this;
 	}
+
+protected:
+	ReferencesPtr refs_;
 };
 
 class InputBinaryStreaming : public InputBinarySerializerNode {
 public:
 	InputBinaryStreaming(IReader* reader)
-	:	InputBinarySerializerNode(reader) {}
+	:	InputBinarySerializerNode(S11N_NULLPTR, reader, &refs_, S11N_NULLPTR) {}
 
 	template <class T>
 	InputBinaryStreaming& operator >> (T& t) {
 		(*((InputBinarySerializerNode*) this)) & t;
 		return *this;
 	}
+
+protected:
+	ReferencesId refs_;
 };
 
 } // namespace bike {
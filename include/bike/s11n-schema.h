@@ -0,0 +1,518 @@
+// s11n
+//
+#pragma once
+
+#include "s11n.h"
+#include <cstdint>
+#ifndef S11N_CPP03
+#include <type_traits>
+#endif
+
+namespace bike {
+
+class SchemaEssence : public OutputEssence {};
+
+/// Description of serializable type, built from its ser() method
+struct Schema {
+	enum Kind {
+		VALUE,    /// Number, string and other raw values
+		OBJECT,   /// Type with fields
+		POINTER,  /// Pointer to object, the only field is pointee
+		SEQUENCE, /// Container, fields are element or key and value
+		RECURSIVE,/// Object, which is already described above
+		OPTIONAL, /// Value, which may be absent, the only field is value
+		VARIANT   /// One of alternatives, which are fields
+	};
+
+	std::string         name;     /// Empty for unnamed fields
+	TypeIndex           info;
+	const char*         raw;      /// Name of raw value type, same on every compiler
+	Kind                kind;
+	unsigned            version;
+	unsigned            size;     /// Number of elements of fixed size sequence, 0 for others
+	bool                optional;
+	bool                base;     /// Fields of base class
+	bool                polymorphic; /// Pointer, which may point to derived types
+	std::vector<Schema> fields;
+
+	Schema(const char* name, const TypeIndex& info, Kind kind = OBJECT)
+	:	name(name? name : ""), info(info), raw(""), kind(kind), version(0), size(0), optional(false), base(false), polymorphic(false) {}
+};
+
+template <class T>
+class SchemaCall;
+
+#ifdef S11N_CPP03
+/// Abstract types can't be array elements, so they fail first test
+template <class T>
+class SchemaAbstract {
+	template <class U>
+	static char test(U(*)[1]);
+	template <class U>
+	static long test(...);
+
+public:
+	static const bool value = sizeof(test<T>(S11N_NULLPTR)) != sizeof(char);
+};
+
+/// Polymorphic types aren't detected without type traits, only abstract ones are known
+template <class T>
+class SchemaPolymorphic {
+public:
+	static const bool value = SchemaAbstract<T>::value;
+};
+#else
+template <class T>
+class SchemaAbstract {
+public:
+	static const bool value = std::is_abstract<T>::value;
+};
+
+template <class T>
+class SchemaPolymorphic {
+public:
+	static const bool value = std::is_polymorphic<T>::value;
+};
+#endif
+
+template <class T, bool Abstract = SchemaAbstract<T>::value>
+class SchemaPointee;
+
+/// Walks ser() methods with default constructed objects and records fields to schema
+class SchemaNode {
+public:
+	SchemaNode(Schema* schema, std::vector<TypeIndex>* path)
+	:	schema_(schema),
+		path_(path) {}
+
+	void decl_version(unsigned ver) {
+		schema_->version = ver;
+	}
+
+	unsigned version() const {
+		return schema_->version;
+	}
+
+	template <class Base>
+	SchemaNode& base(Base* base_ptr) {
+		named(*static_cast<Base*>(base_ptr), "");
+		schema_->fields.back().base = true;
+		return *this;
+	}
+
+	template <class T>
+	SchemaNode& operator & (T& t) {
+		return named(t, "");
+	}
+
+	template <class T>
+	SchemaNode& named(T& t, const char* name) {
+		schema_->fields.push_back(Schema(name, typeid(T)));
+		SchemaNode node(&schema_->fields.back(), path_);
+		SchemaCall<T&>::call(t, node);
+		return *this;
+	}
+
+	template <class T>
+	void optional(T& t, const char* name, const T& def) {
+		named(t, name);
+		schema_->fields.back().optional = true;
+	}
+
+	/// Schema has no values, so constructors get defaults
+	template <class T>
+	bool search(T&, const char*) {
+		return false;
+	}
+
+	/// Pointee is walked like an element, so it's part of fingerprint
+	template <class T>
+	void ptr_impl(T*) {
+		schema_->kind = Schema::POINTER;
+		schema_->info = typeid(T);
+		schema_->polymorphic = SchemaPolymorphic<T>::value;
+		SchemaPointee<T>::describe(*this);
+	}
+
+	/// Walks object fields, unless the same type is walked already by one of parents
+	template <class T>
+	void object(T& t) {
+		const TypeIndex info = typeid(T);
+		if (std::find(path_->begin(), path_->end(), info) != path_->end()) {
+			schema_->kind = Schema::RECURSIVE;
+			return;
+		}
+		path_->push_back(info);
+		t.ser(*this);
+		path_->pop_back();
+	}
+
+	/// Sequence element is described with default constructed element
+	template <class T>
+	void sequence() {
+		schema_->kind = Schema::SEQUENCE;
+		element<T>();
+	}
+
+	/// Unnamed field, described with default constructed value
+	template <class T>
+	void element() {
+		T t(Ctor<T, SchemaNode>::ctor(*this));
+		named(t, "");
+	}
+
+	Schema& schema() const { return *schema_; }
+
+	SchemaEssence essence() { return SchemaEssence(); }
+
+protected:
+	Schema*                 schema_;
+	std::vector<TypeIndex>* path_;
+};
+
+template <class T>
+class SchemaCall {
+public:
+	static void call(T t, SchemaNode& node) {
+		node.object(t);
+	}
+};
+
+template <class T, bool Abstract>
+class SchemaPointee {
+public:
+	static void describe(SchemaNode& node) {
+		node.element<T>();
+	}
+};
+
+/// Abstract pointee has no object to walk, only concrete types behind it are written
+template <class T>
+class SchemaPointee<T, true> {
+public:
+	static void describe(SchemaNode& node) {
+		node.schema().fields.push_back(Schema(S11N_NULLPTR, typeid(T)));
+	}
+};
+
+template <class T>
+class SchemaCall<T*&> {
+public:
+	static void call(T*& t, SchemaNode& node) {
+		node.ptr_impl(t);
+	}
+};
+
+template <class T, int Size>
+class SchemaCall<T(&)[Size]> {
+public:
+	static void call(T(&)[Size], SchemaNode& node) {
+		node.sequence<T>();
+		node.schema().size = Size;
+	}
+};
+
+#define S11N_SCHEMA_RAW(Type)\
+	template <>\
+	class SchemaCall<Type&> {\
+	public:\
+		static void call(Type&, SchemaNode& node) {\
+			node.schema().kind = Schema::VALUE;\
+			node.schema().raw  = #Type;\
+		}\
+	};
+
+S11N_SCHEMA_RAW(bool);
+S11N_SCHEMA_RAW(char);
+S11N_SCHEMA_RAW(signed char);
+S11N_SCHEMA_RAW(unsigned char);
+S11N_SCHEMA_RAW(short);
+S11N_SCHEMA_RAW(unsigned short);
+S11N_SCHEMA_RAW(int);
+S11N_SCHEMA_RAW(unsigned int);
+S11N_SCHEMA_RAW(long);
+S11N_SCHEMA_RAW(unsigned long);
+S11N_SCHEMA_RAW(long long);
+S11N_SCHEMA_RAW(unsigned long long);
+S11N_SCHEMA_RAW(float);
+S11N_SCHEMA_RAW(double);
+S11N_SCHEMA_RAW(std::string);
+
+#undef S11N_SCHEMA_RAW
+
+#define S11N_SCHEMA_OUT(Type, Function)\
+	template <>\
+	class SchemaCall<Type&> {\
+	public:\
+		static void call(Type& t, SchemaNode& node) {\
+			Function(t, node);\
+		}\
+	};
+
+/// Schema of type T
+template <class T>
+Schema describe() {
+	Schema schema(S11N_NULLPTR, typeid(T));
+	std::vector<TypeIndex> path;
+	SchemaNode node(&schema, &path);
+	T t(Ctor<T, SchemaNode>::ctor(node));
+	SchemaCall<T&>::call(t, node);
+	return schema;
+}
+
+/// Hash of schema structure: kinds, names, raw types, versions, sizes and flags of all fields.
+/// Pointer to polymorphic type may point to derived types, which aren't part of schema,
+/// so such schemas have no fingerprint and 0 is returned
+class Fingerprint {
+public:
+	static uint64_t of(const Schema& schema) {
+		if (polymorphic(schema))
+			return 0;
+		uint64_t hash = 14695981039346656037ull; // FNV-1a
+		mix(hash, schema);
+		return hash != 0? hash : 1;
+	}
+
+protected:
+	static bool polymorphic(const Schema& schema) {
+		if (schema.polymorphic)
+			return true;
+		for (size_t i = 0; i < schema.fields.size(); ++i)
+			if (polymorphic(schema.fields[i]))
+				return true;
+		return false;
+	}
+
+	static void mix(uint64_t& hash, const Schema& schema) {
+		mix(hash, unsigned(schema.kind));
+		mix(hash, schema.name.c_str());
+		mix(hash, schema.raw);
+		mix(hash, schema.version);
+		mix(hash, schema.size);
+		mix(hash, unsigned(schema.optional) | unsigned(schema.base) << 1);
+		mix(hash, unsigned(schema.fields.size()));
+		for (size_t i = 0; i < schema.fields.size(); ++i)
+			mix(hash, schema.fields[i]);
+	}
+
+	static void mix(uint64_t& hash, unsigned value) {
+		for (int i = 0; i < 4; ++i, value >>= 8)
+			hash = (hash ^ (value & 0xFF)) * 1099511628211ull;
+	}
+
+	static void mix(uint64_t& hash, const char* str) {
+		for (; *str; ++str)
+			hash = (hash ^ static_cast<unsigned char>(*str)) * 1099511628211ull;
+		hash = hash * 1099511628211ull; // Terminator, so "ab" + "c" differs from "a" + "bc"
+	}
+};
+
+/// Fingerprint of type T, computed once. 0 if T can't be written in positional layout
+template <class T>
+uint64_t fingerprint() {
+	static const uint64_t fp = Fingerprint::of(describe<T>());
+	return fp;
+}
+
+} // namespace bike {
+
+#ifdef S11N_USE_VECTOR
+#include <vector>
+namespace bike {
+template <class T>
+class SchemaCall<std::vector<T>&> {
+public:
+	static void call(std::vector<T>&, SchemaNode& node) {
+		node.sequence<T>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_VECTOR
+
+#ifdef S11N_USE_LIST
+#include <list>
+namespace bike {
+template <class T>
+class SchemaCall<std::list<T>&> {
+public:
+	static void call(std::list<T>&, SchemaNode& node) {
+		node.sequence<T>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_LIST
+
+#if defined(S11N_USE_MEMORY) && !defined(S11N_CPP03)
+#include <memory>
+namespace bike {
+template <class T>
+class SchemaCall<std::unique_ptr<T>&> {
+public:
+	static void call(std::unique_ptr<T>& t, SchemaNode& node) {
+		node.ptr_impl(t.get());
+	}
+};
+
+template <class T>
+class SchemaCall<std::shared_ptr<T>&> {
+public:
+	static void call(std::shared_ptr<T>& t, SchemaNode& node) {
+		node.ptr_impl(t.get());
+	}
+};
+} // namespace bike {
+#endif // #if defined(S11N_USE_MEMORY) && !defined(S11N_CPP03)
+
+#ifndef S11N_CPP03
+
+#ifdef S11N_USE_DEQUE
+#include <deque>
+namespace bike {
+template <class T>
+class SchemaCall<std::deque<T>&> {
+public:
+	static void call(std::deque<T>&, SchemaNode& node) {
+		node.sequence<T>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_DEQUE
+
+#ifdef S11N_USE_ARRAY
+#include <array>
+namespace bike {
+template <class T, size_t Size>
+class SchemaCall<std::array<T, Size>&> {
+public:
+	static void call(std::array<T, Size>&, SchemaNode& node) {
+		node.sequence<T>();
+		node.schema().size = unsigned(Size);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_ARRAY
+
+#ifdef S11N_USE_MAP
+#include <map>
+namespace bike {
+template <class K, class V, class C, class A>
+class SchemaCall<std::map<K, V, C, A>&> {
+public:
+	static void call(std::map<K, V, C, A>&, SchemaNode& node) {
+		node.sequence<K>();
+		node.element<V>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_MAP
+
+#ifdef S11N_USE_UNORDERED_MAP
+#include <unordered_map>
+namespace bike {
+template <class K, class V, class H, class E, class A>
+class SchemaCall<std::unordered_map<K, V, H, E, A>&> {
+public:
+	static void call(std::unordered_map<K, V, H, E, A>&, SchemaNode& node) {
+		node.sequence<K>();
+		node.element<V>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_UNORDERED_MAP
+
+#ifdef S11N_USE_SET
+#include <set>
+namespace bike {
+template <class T, class C, class A>
+class SchemaCall<std::set<T, C, A>&> {
+public:
+	static void call(std::set<T, C, A>&, SchemaNode& node) {
+		node.sequence<T>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_SET
+
+#ifdef S11N_USE_UTILITY
+#include <utility>
+namespace bike {
+template <class T1, class T2>
+class SchemaCall<std::pair<T1, T2>&> {
+public:
+	static void call(std::pair<T1, T2>&, SchemaNode& node) {
+		node.element<T1>();
+		node.element<T2>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_UTILITY
+
+#if defined(S11N_USE_TUPLE) || (defined(S11N_CPP17) && defined(S11N_USE_VARIANT))
+namespace bike {
+/// Describes types as unnamed fields one by one
+template <class... Types>
+class SchemaElements;
+
+template <>
+class SchemaElements<> {
+public:
+	static void describe(SchemaNode&) {}
+};
+
+template <class T, class... Rest>
+class SchemaElements<T, Rest...> {
+public:
+	static void describe(SchemaNode& node) {
+		node.element<T>();
+		SchemaElements<Rest...>::describe(node);
+	}
+};
+} // namespace bike {
+#endif
+
+#ifdef S11N_USE_TUPLE
+#include <tuple>
+namespace bike {
+template <class... Types>
+class SchemaCall<std::tuple<Types...>&> {
+public:
+	static void call(std::tuple<Types...>&, SchemaNode& node) {
+		SchemaElements<Types...>::describe(node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_TUPLE
+
+#ifdef S11N_CPP17
+
+#ifdef S11N_USE_OPTIONAL
+#include <optional>
+namespace bike {
+template <class T>
+class SchemaCall<std::optional<T>&> {
+public:
+	static void call(std::optional<T>&, SchemaNode& node) {
+		node.schema().kind = Schema::OPTIONAL;
+		node.element<T>();
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_OPTIONAL
+
+#ifdef S11N_USE_VARIANT
+#include <variant>
+namespace bike {
+template <class... Types>
+class SchemaCall<std::variant<Types...>&> {
+public:
+	static void call(std::variant<Types...>&, SchemaNode& node) {
+		node.schema().kind = Schema::VARIANT;
+		SchemaElements<Types...>::describe(node);
+	}
+};
+} // namespace bike {
+#endif // #ifdef S11N_USE_VARIANT
+
+#endif // #ifdef S11N_CPP17
+
+#endif // #ifndef S11N_CPP03
@@ -3,51 +3,10 @@
 #pragma once
 
 #include "s11n-xml.h"
-#include <iterator>
+#include <vector>
 
 namespace bike {
 
-template <class T>
-class InputXmlIter : public std::iterator<std::input_iterator_tag, T> {
-public:
-	InputXmlIter(InputXmlSerializerNode* parent, pugi::xml_node::iterator iter)
-	:	parent_(parent),
-		iter_(iter) {}
-
-	InputXmlIter(const InputXmlIter& i)
-	:	parent_(i.parent_),
-		iter_(i.iter_) {}
-
-	InputXmlIter operator ++() {
-		++iter_;
-		return *this;
-	}
-
-	InputXmlIter operator ++(int) {
-		iter_++;
-		return *this;
-	}
-
-	T operator *() {
-		InputXmlSerializerNode node(parent_, *iter_, parent_->refs());
-		T t(Ctor<T, InputXmlSerializerNode>::ctor(node));
-		InputXmlSerializerCall<T&>::call(t, node);
-		return t;
-	}
-
-	bool operator == (const InputXmlIter& i) const {
-		return iter_ == i.iter_;
-	}
-
-	bool operator != (const InputXmlIter& i) const {
-		return iter_ != i.iter_;
-	}
-
-protected:
-	InputXmlSerializerNode*  parent_;
-	pugi::xml_node::iterator iter_;
-};
-
 class XmlSequence {
 public:
 	template <class Cont>
@@ -55,12 +14,28 @@ public:
 		read<Cont, Cont::value_type>(container, node);
 	}
 
+	/// Elements are constructed in container and read there, so they aren't copied
 	template <class Cont, class T>
 	static void read(Cont& container, InputXmlSerializerNode& node) {
-		InputXmlIter<T> b(&node, node.xml().begin());
-		InputXmlIter<T> e(&node, node.xml().end());
-		Cont tmp(b, e);
-		std::swap(container, tmp);
+		container.clear();
+		reserve(container, node.xml());
+		for (pugi::xml_node child = node.xml().first_child(); child; child = child.next_sibling()) {
+			InputXmlSerializerNode item(&node, child, node.refs());
+			container.push_back(Ctor<T, InputXmlSerializerNode>::ctor(item));
+			InputXmlSerializerCall<T&>::call(container.back(), item);
+		}
+	}
+
+	/// Elements of vector<bool> are proxies, so they are read to local value and then added
+	static void read(std::vector<bool>& container, InputXmlSerializerNode& node) {
+		container.clear();
+		reserve(container, node.xml());
+		for (pugi::xml_node child = node.xml().first_child(); child; child = child.next_sibling()) {
+			InputXmlSerializerNode item(&node, child, node.refs());
+			bool value = false;
+			InputXmlSerializerCall<bool&>::call(value, item);
+			container.push_back(value);
+		}
 	}
 
 	template <class Cont>
@@ -68,12 +43,33 @@ public:
 		XmlSequence::write(container.begin(), container.end(), node);
 	}
 
+	static void write(std::vector<bool>& container, OutputXmlSerializerNode& node) {
+		node.concept("SEQ");
+		for (size_t i = 0; i < container.size(); ++i) {
+			bool value = container[i];
+			node.named(value, "");
+		}
+	}
+
 	template <class FwdIter>
 	static void write(FwdIter begin, FwdIter end, OutputXmlSerializerNode& node) {
-		node.xml().append_attribute("concept") = "SEQ";
+		node.concept("SEQ");
 		for (; begin != end; ++begin)
 			node.named(*begin, "");
 	}
+
+protected:
+	template <class Cont>
+	static void reserve(Cont&, pugi::xml_node) {}
+
+	/// Children are counted, so vector is allocated once
+	template <class T>
+	static void reserve(std::vector<T>& container, pugi::xml_node xml) {
+		size_t size = 0;
+		for (pugi::xml_node child = xml.first_child(); child; child = child.next_sibling())
+			++size;
+		container.reserve(size);
+	}
 };
 
 } // namespace bike
@@ -81,18 +77,23 @@ public:
 #ifdef S11N_USE_STRING
 #include <string>
 namespace bike {
+template <>
+struct XmlRaw<std::string> {
+	enum { value = 1 };
+};
+
 template <>
 class OutputXmlSerializerCall<std::string&> {
 public:
 	static void call(std::string& t, OutputXmlSerializerNode& node) {
-		node.xml().append_attribute("value").set_value(t.c_str());
+		node.value(t.c_str());
 	}
 };
 template <>
 class InputXmlSerializerCall<std::string&> {
 public:
 	static void call(std::string& t, InputXmlSerializerNode& node) {
-		pugi::xml_attribute attr = node.xml().attribute("value");
+		pugi::xml_attribute attr = node.value();
 		S11N_ASSERT(attr);
 		t = std::string(attr.as_string());
 	}
@@ -103,18 +104,98 @@ public:
 #ifdef S11N_USE_VECTOR
 #include <vector>
 namespace bike {
+/// Arithmetic types, which vectors can be packed to one attribute
+template <class T>
+struct XmlPacked { enum { value = 0 }; };
+
+#define SN_PACKED(Type)\
+	template <>\
+	struct XmlPacked<Type> { enum { value = 1 }; };
+
+SN_PACKED(char);
+SN_PACKED(unsigned char);
+SN_PACKED(short);
+SN_PACKED(unsigned short);
+SN_PACKED(int);
+SN_PACKED(unsigned);
+SN_PACKED(float);
+SN_PACKED(double);
+
+#undef SN_PACKED
+
+template <bool Packed>
+class XmlVector {
+public:
+	template <class T>
+	static void write(std::vector<T>& t, OutputXmlSerializerNode& node) {
+		XmlSequence::write(t, node);
+	}
+
+	template <class T>
+	static void read(std::vector<T>& t, InputXmlSerializerNode& node) {
+		XmlSequence::read(t, node);
+	}
+};
+
+template <>
+class XmlVector<true> {
+public:
+	template <class T>
+	static void write(std::vector<T>& t, OutputXmlSerializerNode& node) {
+		if (!node.packed()) {
+			XmlSequence::write(t, node);
+			return;
+		}
+		node.concept("B64");
+		if (t.empty() || XmlBase64::little_endian())
+			node.base64(t.empty()? S11N_NULLPTR : &t[0], t.size() * sizeof(T));
+		else {
+			std::vector<T> bytes(t);
+			XmlBase64::to_little_endian(&bytes[0], bytes.size(), sizeof(T));
+			node.base64(&bytes[0], bytes.size() * sizeof(T));
+		}
+	}
+
+	template <class T>
+	static void read(std::vector<T>& t, InputXmlSerializerNode& node) {
+		if (std::strcmp(node.concept(), "B64") != 0) {
+			XmlSequence::read(t, node);
+			return;
+		}
+		bool decoded = unpack(node.value().value(), t);
+		S11N_ASSERT(decoded && "Invalid packed array!");
+	}
+
+	/// Decodes base64 to vector. Vector is left unchanged for corrupted value
+	template <class T>
+	static bool unpack(const char* value, std::vector<T>& t) {
+		const size_t length = std::strlen(value);
+		const size_t size = XmlBase64::decoded_size(value, length);
+		if (length % 4 != 0 || size % sizeof(T) != 0)
+			return false;
+		std::vector<T> tmp(size / sizeof(T));
+		if (!tmp.empty()) {
+			if (!XmlBase64::decode(value, length, reinterpret_cast<unsigned char*>(&tmp[0])))
+				return false;
+			XmlBase64::to_little_endian(&tmp[0], tmp.size(), sizeof(T));
+		}
+		t.swap(tmp);
+		return true;
+	}
+};
+
 template <class T>
 class OutputXmlSerializerCall<std::vector<T>&> {
 public:
 	static void call(std::vector<T>& t, OutputXmlSerializerNode& node) {
-		XmlSequence::write(t, node);
+		XmlVector<XmlPacked<T>::value != 0>::write(t, node);
 	}
 };
 template <class T>
 class InputXmlSerializerCall<std::vector<T>&> {
 public:
 	static void call(std::vector<T>& t, InputXmlSerializerNode& node) {
-		XmlSequence::read(t, node);
+		XmlVector<XmlPacked<T>::value != 0>::read(t, node);
 	}
 };
 } // namespace bike {
@@ -149,7 +230,7 @@ template <class T>
 class OutputXmlSerializerCall<std::unique_ptr<T>&> {
 public:
 	static void call(std::unique_ptr<T>& t, OutputXmlSerializerNode& node) {
-		OutputXmlSerializerNode sub(&node, node.xml(), node.refs());
+		OutputXmlSerializerNode sub(&node, node.writer(), node.refs());
 		T* tmp = t.get();
 		sub & tmp;
 	}
@@ -178,7 +259,23 @@ public:
 	static void call(std::shared_ptr<T>& t, InputXmlSerializerNode& node) {
 		T* ref = S11N_NULLPTR;
 		node.ptr_impl(ref);
-		t.reset(ref);
+		if (ref == S11N_NULLPTR) {
+			t.reset();
+			return;
+		}
+
+		if (Unshared<T>::value) {
+			t.reset(ref);
+			return;
+		}
+
+		std::shared_ptr<void> owner = node.refs()->owner(ref);
+		if (owner)
+			t = std::shared_ptr<T>(owner, ref);
+		else {
+			t.reset(ref);
+			node.refs()->set_owner(ref, t);
+		}
 	}
 };
 } // namespace bike {
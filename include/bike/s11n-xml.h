@@ -5,6 +5,34 @@
 #include "s11n.h"
 #include <pugixml.hpp>
 #include <iterator>
+#include <istream>
+#include <ostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <fstream>
+
+#ifdef S11N_CPP17
+#	include <charconv>
+#	ifdef __cpp_lib_to_chars
+#		define S11N_CHARCONV
+#	endif
+#endif
+
+#ifdef S11N_USE_MMAP
+#	ifdef _WIN32
+#		ifndef NOMINMAX
+#			define NOMINMAX
+#		endif
+#		include <windows.h>
+#	else
+#		include <fcntl.h>
+#		include <sys/mman.h>
+#		include <sys/stat.h>
+#		include <unistd.h>
+#	endif
+#endif
 
 namespace bike {
 
@@ -12,17 +40,540 @@ class XmlSerializerStorage {
 	S11N_TYPE_STORAGE
 };
 
+/// Conversion of numbers in attributes. With std::to_chars and std::from_chars it's locale independent,
+/// and floating point numbers are written in shortest form, which is read back exactly. Otherwise
+/// C library writes all digits, and its decimal point follows C locale, so keep it "C"
+class XmlNumber {
+public:
+	enum { SIZE = 32 };
+
+	/// Writes number to buffer of SIZE chars. Returns end of written chars
+	static char* format(char* buf, int value) {
+		if (value >= 0)
+			return format(buf, unsigned(value));
+		*buf = '-';
+		return format(buf + 1, 0u - unsigned(value));
+	}
+
+	static char* format(char* buf, unsigned value) {
+#ifdef S11N_CHARCONV
+		return std::to_chars(buf, buf + SIZE, value).ptr;
+#else
+		char digits[16];
+		char* end = digits;
+		do {
+			*end++ = char('0' + value % 10);
+			value /= 10;
+		} while (value != 0);
+		while (end != digits)
+			*buf++ = *--end;
+		return buf;
+#endif
+	}
+
+	static char* format(char* buf, float value) {
+#ifdef S11N_CHARCONV
+		return std::to_chars(buf, buf + SIZE, value).ptr;
+#else
+		return buf + std::sprintf(buf, "%.9g", value);
+#endif
+	}
+
+	static char* format(char* buf, double value) {
+#ifdef S11N_CHARCONV
+		return std::to_chars(buf, buf + SIZE, value).ptr;
+#else
+		return buf + std::sprintf(buf, "%.17g", value);
+#endif
+	}
+
+	/// Parsing functions return 0 for invalid strings, like pugixml does
+	static int as_int(const char* str) {
+		int value = 0;
+		if (!parse(str, value))
+			value = int(integer(str));
+		return value;
+	}
+
+	static unsigned as_uint(const char* str) {
+		unsigned value = 0;
+		if (!parse(str, value))
+			value = unsigned(integer(str));
+		return value;
+	}
+
+	static float as_float(const char* str) {
+		float value = 0;
+		if (!parse(str, value))
+			value = float(std::strtod(str, S11N_NULLPTR));
+		return value;
+	}
+
+	static double as_double(const char* str) {
+		double value = 0;
+		if (!parse(str, value))
+			value = std::strtod(str, S11N_NULLPTR);
+		return value;
+	}
+
+	static bool as_bool(const char* str) {
+		const char first = *str; // Same as pugixml: 1, true, True, yes, Yes
+		return first == '1' || first == 't' || first == 'T' || first == 'y' || first == 'Y';
+	}
+
+protected:
+	/// Integer with spaces, sign or hex prefix "0x", which pugixml accepts too
+	static unsigned long integer(const char* str) {
+		while (*str == ' ' || *str == '\t' || *str == '\r' || *str == '\n')
+			++str;
+		const bool negative = *str == '-';
+		if (*str == '-' || *str == '+')
+			++str;
+		const bool hex = str[0] == '0' && (str[1] == 'x' || str[1] == 'X');
+		const unsigned long value = std::strtoul(hex? str + 2 : str, S11N_NULLPTR, hex? 16 : 10);
+		return negative? 0ul - value : value;
+	}
+
+	/// Strict parsing of whole string. Other formats are left to C library
+	template <class T>
+	static bool parse(const char* str, T& value) {
+#ifdef S11N_CHARCONV
+		const char* end = str + std::strlen(str);
+		std::from_chars_result result = std::from_chars(str, end, value);
+		return result.ec == std::errc() && result.ptr == end;
+#else
+		return false;
+#endif
+	}
+};
+
+/// Base64 for packed arrays of numbers. Bytes are little-endian on every machine
+class XmlBase64 {
+public:
+	static size_t encoded_size(size_t size) {
+		return (size + 2) / 3 * 4;
+	}
+
+	/// Writes encoded_size(size) chars
+	static void encode(const unsigned char* data, size_t size, char* out) {
+		static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		const unsigned char* end = data + size / 3 * 3;
+		for (; data != end; data += 3, out += 4) {
+			const unsigned triple = unsigned(data[0]) << 16 | unsigned(data[1]) << 8 | data[2];
+			out[0] = alphabet[triple >> 18];
+			out[1] = alphabet[(triple >> 12) & 0x3F];
+			out[2] = alphabet[(triple >> 6) & 0x3F];
+			out[3] = alphabet[triple & 0x3F];
+		}
+		const size_t rest = size % 3;
+		if (rest != 0) {
+			const unsigned triple = unsigned(data[0]) << 16 | (rest == 2? unsigned(data[1]) << 8 : 0u);
+			out[0] = alphabet[triple >> 18];
+			out[1] = alphabet[(triple >> 12) & 0x3F];
+			out[2] = rest == 2? alphabet[(triple >> 6) & 0x3F] : '=';
+			out[3] = '=';
+		}
+	}
+
+	static size_t decoded_size(const char* str, size_t length) {
+		if (length < 4)
+			return 0;
+		return length / 4 * 3 - (str[length - 1] == '=') - (str[length - 2] == '=');
+	}
+
+	/// Writes decoded_size() bytes. Returns false for invalid string. 
+	/// Padding is allowed in last group only, and "x=y" isn't valid there
+	static bool decode(const char* str, size_t length, unsigned char* out) {
+		static const Table table;
+		if (length % 4 != 0)
+			return false;
+		const size_t size = decoded_size(str, length);
+		for (size_t i = 0, o = 0; i < length; i += 4) {
+			const bool last = i + 4 == length;
+			const bool pad2 = last && str[i + 2] == '=';
+			const bool pad3 = last && str[i + 3] == '=';
+			if (pad2 && !pad3)
+				return false;
+			const int a = table.values[static_cast<unsigned char>(str[i])];
+			const int b = table.values[static_cast<unsigned char>(str[i + 1])];
+			const int c = pad2? 0 : table.values[static_cast<unsigned char>(str[i + 2])];
+			const int d = pad3? 0 : table.values[static_cast<unsigned char>(str[i + 3])];
+			if ((a | b | c | d) < 0) // '=' out of last group isn't in table too
+				return false;
+			const unsigned triple = unsigned(a) << 18 | unsigned(b) << 12 | unsigned(c) << 6 | unsigned(d);
+			out[o++] = static_cast<unsigned char>(triple >> 16);
+			if (o < size)
+				out[o++] = static_cast<unsigned char>(triple >> 8);
+			if (o < size)
+				out[o++] = static_cast<unsigned char>(triple);
+		}
+		return true;
+	}
+
+	static bool little_endian() {
+		const unsigned one = 1;
+		return *reinterpret_cast<const unsigned char*>(&one) == 1;
+	}
+
+	/// Reverses bytes of every element on big-endian machines
+	static void to_little_endian(void* data, size_t count, size_t element) {
+		if (little_endian())
+			return;
+		unsigned char* bytes = static_cast<unsigned char*>(data);
+		for (size_t i = 0; i < count; ++i, bytes += element)
+			std::reverse(bytes, bytes + element);
+	}
+
+protected:
+	struct Table {
+		signed char values[256];
+
+		Table() {
+			static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+			std::memset(values, -1, sizeof(values));
+			for (int i = 0; i < 64; ++i)
+				values[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+		}
+	};
+};
+
+/// Writes elements straight to stream, so memory depends on depth of objects only.
+/// Start tag is left open for attributes until first child or end of element
+class XmlWriter {
+public:
+	enum { BUFFER_SIZE = 64 * 1024 };
+
+	explicit XmlWriter(std::ostream* out)
+	:	out_(out),
+		open_(false) {
+		buf_.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+	}
+
+	void start(const char* tag) {
+		close_start_tag();
+		buf_ += '<';
+		buf_ += tag;
+		tags_.push_back(tag);
+		open_ = true;
+	}
+
+	void attribute(const char* name, const char* value) {
+		attribute_name(name);
+		escape(value);
+		buf_ += '"';
+	}
+
+	void attribute(const char* name, int value) {
+		number(name, value);
+	}
+
+	void attribute(const char* name, unsigned value) {
+		number(name, value);
+	}
+
+	void attribute(const char* name, float value) {
+		number(name, value);
+	}
+
+	void attribute(const char* name, double value) {
+		number(name, value);
+	}
+
+	void attribute(const char* name, bool value) {
+		attribute(name, value? "true" : "false");
+	}
+
+	/// Bytes encoded to base64 need no escaping
+	void base64_attribute(const char* name, const void* data, size_t size) {
+		attribute_name(name);
+		const size_t at = buf_.size();
+		buf_.resize(at + XmlBase64::encoded_size(size));
+		if (size != 0)
+			XmlBase64::encode(static_cast<const unsigned char*>(data), size, &buf_[at]);
+		buf_ += '"';
+	}
+
+	/// Attributes can be added to current element
+	bool in_start_tag() const {
+		return open_;
+	}
+
+	/// Open start tag has attribute. Only names of this tag are compared, not values
+	bool has_attribute(const char* name) const {
+		S11N_ASSERT(open_);
+		const size_t length = std::strlen(name);
+		for (size_t i = 0; i < names_.size(); ++i) {
+			if (buf_.compare(names_[i], length, name) == 0 && buf_[names_[i] + length] == '=')
+				return true;
+		}
+		return false;
+	}
+
+	void end() {
+		S11N_ASSERT(!tags_.empty());
+		if (open_)
+			buf_ += " />";
+		else {
+			buf_ += "</";
+			buf_ += tags_.back();
+			buf_ += '>';
+		}
+		open_ = false;
+		names_.clear();
+		tags_.pop_back();
+		if (buf_.size() >= BUFFER_SIZE)
+			flush();
+	}
+
+	/// Buffer, which has grown for huge values, is shrunk back
+	void flush() {
+		out_->write(buf_.data(), buf_.size());
+		if (buf_.capacity() > 2 * BUFFER_SIZE) {
+			std::string().swap(buf_);
+			buf_.reserve(BUFFER_SIZE + BUFFER_SIZE / 4);
+		}
+		else
+			buf_.clear();
+	}
+
+protected:
+	/// Numbers need no escaping
+	template <class T>
+	void number(const char* name, T value) {
+		char buf[XmlNumber::SIZE];
+		attribute_name(name);
+		buf_.append(buf, XmlNumber::format(buf, value));
+		buf_ += '"';
+	}
+
+	/// Name is remembered by its place in buffer, so caller's buffer may be reused
+	void attribute_name(const char* name) {
+		S11N_ASSERT(open_ && "Attributes must be written before children");
+		buf_ += ' ';
+		names_.push_back(buf_.size());
+		buf_ += name;
+		buf_ += "=\"";
+	}
+
+	void close_start_tag() {
+		if (open_)
+			buf_ += '>';
+		open_ = false;
+		names_.clear();
+	}
+
+	/// Same escaping as pugixml uses for attributes
+	void escape(const char* s) {
+		for (; *s; ++s) {
+			const unsigned char ch = static_cast<unsigned char>(*s);
+			switch (ch) {
+			case '&': buf_ += "&amp;"; break;
+			case '<': buf_ += "&lt;"; break;
+			case '>': buf_ += "&gt;"; break;
+			case '"': buf_ += "&quot;"; break;
+			default:
+				if (ch < 32 && ch != '\t') {
+					char code[8];
+					std::sprintf(code, "&#%u%u;", ch / 10, ch % 10);
+					buf_ += code;
+				}
+				else
+					buf_ += *s;
+			}
+		}
+	}
+
+	std::ostream*            out_;
+	std::string              buf_;
+	std::vector<const char*> tags_;
+	bool                     open_;
+	std::vector<size_t>      names_; /// Offsets of attribute names of open start tag in buffer
+};
+
+/// Names of elements and attributes. Compact dialect (format version 3) has short names 
+/// and writes named fields of raw types as attributes of their objects
+struct XmlDialect {
+	unsigned    fmtver;
+	const char* object;
+	const char* name;
+	const char* value;
+	const char* ref;
+	const char* type;
+	const char* concept;
+	bool        inline_raw;
+
+	static const XmlDialect& full() {
+		static const XmlDialect dialect = { 2, "object", "name", "value", "ref", "type", "concept", false };
+		return dialect;
+	}
+
+	static const XmlDialect& compact() {
+		static const XmlDialect dialect = { 3, "o", "n", "v", "r", "t", "c", true };
+		return dialect;
+	}
+
+	static const XmlDialect& of(unsigned fmtver) {
+		return fmtver >= compact().fmtver? compact() : full();
+	}
+
+	/// Field can be attribute, if its name is XML name, which doesn't clash with dialect attributes
+	bool inlined(const char* field) const {
+		if (!inline_raw || field == S11N_NULLPTR || !(letter(field[0]) || field[0] == '_'))
+			return false;
+		for (const char* c = field + 1; *c; ++c) {
+			if (!letter(*c) && !(*c >= '0' && *c <= '9') && *c != '_' && *c != '-' && *c != '.')
+				return false;
+		}
+		return std::strcmp(field, name) != 0 && std::strcmp(field, value) != 0 && std::strcmp(field, ref) != 0 
+			&& std::strcmp(field, type) != 0 && std::strcmp(field, concept) != 0 && std::strcmp(field, "ver") != 0;
+	}
+
+	static bool letter(char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	}
+};
+
+/// Types, which are written as single value
+template <class T>
+struct XmlRaw {
+	enum { value = 0 };
+};
+
+template <int Size>
+struct XmlRaw<char[Size]> {
+	enum { value = 1 };
+};
+
+/// Versions of types declared in stream. Version of registered type is written once, in the record, 
+/// where type appears first. Objects with other versions and versioned objects of unregistered types 
+/// keep version in "ver" attribute
+/// Version of type found in one state of table. Repeated objects of the type skip lookup in table
+struct XmlVersionCache {
+	unsigned stamp;
+	unsigned version;
+
+	XmlVersionCache() : stamp(0), version(0) {}
+};
+
+class XmlVersionTable {
+public:
+	XmlVersionTable() : stamp_(next_stamp()) {}
+
+	/// Key of registered type. Unregistered types aren't kept in table, 
+	/// because their names differ between compilers
+	static std::string key(const std::type_info& info) {
+		const Type* type = TypeStorageAccessor<XmlSerializerStorage>::find(info);
+		if (type == S11N_NULLPTR)
+			return std::string();
+		char buf[16];
+		std::sprintf(buf, "%u", type->key);
+		return buf;
+	}
+
+	/// Notes version of object. Table keeps version of first object of every registered type. 
+	/// Returns false, if object must keep its version itself
+	bool note(const std::type_info& info, unsigned ver) {
+		std::map<TypeIndex, unsigned>::const_iterator noted = noted_.find(TypeIndex(info));
+		if (noted != noted_.end())
+			return noted->second == ver;
+		const std::string type_key = key(info);
+		if (type_key.empty()) { // Only version 0 is implied for unregistered types
+			noted_.insert(std::make_pair(TypeIndex(info), 0u));
+			return ver == 0;
+		}
+		noted_.insert(std::make_pair(TypeIndex(info), ver));
+		if (ver != 0)
+			pending_.push_back(std::make_pair(type_key, ver));
+		return true;
+	}
+
+	/// Appends versions of types, which are new in record
+	void flush(XmlWriter& writer) {
+		if (pending_.empty())
+			return;
+		writer.start("versions");
+		for (size_t i = 0; i < pending_.size(); ++i) {
+			writer.start("type");
+			writer.attribute("key", pending_[i].first.c_str());
+			writer.attribute("ver", pending_[i].second);
+			writer.end();
+		}
+		writer.end();
+		pending_.clear();
+	}
+
+	void load(pugi::xml_node record) {
+		pugi::xml_node type = record.child("versions").child("type");
+		if (type) {
+			found_.clear(); // Some types may get versions
+			stamp_ = next_stamp();
+		}
+		for (; type; type = type.next_sibling("type"))
+			declared_[type.attribute("key").as_string()] = type.attribute("ver").as_uint();
+	}
+
+	unsigned find(const std::type_info& info) {
+		std::map<TypeIndex, unsigned>::const_iterator found = found_.find(TypeIndex(info));
+		if (found != found_.end())
+			return found->second;
+		const std::string type_key = key(info);
+		std::map<std::string, unsigned>::const_iterator declared = 
+			type_key.empty()? declared_.end() : declared_.find(type_key);
+		unsigned ver = declared != declared_.end()? declared->second : 0;
+		found_.insert(std::make_pair(TypeIndex(info), ver));
+		return ver;
+	}
+
+	/// Lookup remembering result in cache of call site, until table changes. Cache must be thread local
+	unsigned find(const std::type_info& info, XmlVersionCache& cache) {
+		if (cache.stamp != stamp_) {
+			cache.version = find(info);
+			cache.stamp   = stamp_;
+		}
+		return cache.version;
+	}
+
+protected:
+	/// Stamps are unique for all tables, so cache doesn't confuse tables
+	static unsigned next_stamp() {
+#ifdef S11N_CPP03
+		static unsigned stamp = 0;
+#else
+		static std::atomic<unsigned> stamp(0);
+#endif
+		return ++stamp;
+	}
+
+	std::map<TypeIndex, unsigned>                     noted_;
+	std::vector<std::pair<std::string, unsigned> >    pending_;
+	std::map<std::string, unsigned>                   declared_;
+	std::map<TypeIndex, unsigned>                     found_;
+	unsigned                                          stamp_;
+};
+
 class OutputXmlSerializerNode {
 public:
-	OutputXmlSerializerNode(OutputXmlSerializerNode* parent, pugi::xml_node node, ReferencesPtr* refs) 
+	OutputXmlSerializerNode(OutputXmlSerializerNode* parent, XmlWriter* writer, ReferencesPtr* refs) 
 	:	parent_(parent),
+		writer_(writer),
 		refs_(refs),
-		xml_(node),
+		versions_(parent? parent->versions_ : S11N_NULLPTR),
+		dialect_(parent? parent->dialect_ : &XmlDialect::full()),
+		value_name_(dialect_->value),
+		type_(S11N_NULLPTR),
 		version_(0),
-		fmtver_(1) {}
+		declared_(false),
+		fmtver_(dialect_->fmtver),
+		packed_(parent? parent->packed_ : false) {}
 
+	/// Version, which differs from version of type in stream table, is written to object
 	void decl_version(unsigned ver) {
-		version_ = ver;
+		version_  = ver;
+		declared_ = true;
+		if (type_ != S11N_NULLPTR && !versions_->note(*type_, ver)) {
+			S11N_ASSERT(writer_->in_start_tag() && "Declare version before fields!");
+			writer_->attribute("ver", ver);
+		}
 	}
 
 	unsigned version() const {
@@ -33,7 +584,7 @@ public:
 	OutputXmlSerializerNode& base(Base* base_ptr) {
 		Base* base = static_cast<Base*>(base_ptr);
 		if (typeid(*base_ptr) != typeid(Base))
-			S11N_ASSERT(TypeStorageAccessor<XmlSerializerStorage>::find(typeid(*base_ptr).name()) != 0 && "Can't serialize type!");
+			S11N_ASSERT(TypeStorageAccessor<XmlSerializerStorage>::find(typeid(*base_ptr)) != 0 && "Can't serialize type!");
 		return *this & (*base);
 	}
 
@@ -42,18 +593,24 @@ public:
 		return named(t, "");
 	}
 
+	/// Names of fields are unique in object. Otherwise repeated name is written as child element,
+	/// so start tag has no duplicate attributes
 	template <class T>
 	OutputXmlSerializerNode& named(T& t, const char* name) {
-		pugi::xml_node xml_node = xml_.append_child("object");
-		OutputXmlSerializerNode node(this, xml_node, refs_);
+		if (XmlRaw<T>::value && writer_->in_start_tag() && dialect_->inlined(name) && !repeated(name)) {
+			OutputXmlSerializerNode node(this, writer_, refs_);
+			node.value_name_ = name;
+			OutputXmlSerializerCall<T&>::call(t, node);
+			return *this;
+		}
 
+		writer_->start(dialect_->object);
 		if (name && name[0] != 0)
-			xml_node.append_attribute("name").set_value(name);
+			writer_->attribute(dialect_->name, name);
 
+		OutputXmlSerializerNode node(this, writer_, refs_);
 		OutputXmlSerializerCall<T&>::call(t, node);
-		xml_node.append_attribute("ver").set_value(node.version());
-
-		TypeWriter<T&>::write(t, xml_node);
+		writer_->end();
 		return *this;
 	}
 
@@ -65,57 +622,95 @@ public:
 			named(t, name);
 	}
 
-	template <class T>
-	class TypeWriter {
-	public:
-		static void write(T&, pugi::xml_node&) {}
-	};
+	/// Attribute of current object. Attributes go before child objects
+	template <class V>
+	void attribute(const char* name, V value) {
+		writer_->attribute(name, value);
+	}
 
-	template <class T>
-	class TypeWriter<T*&> {
-	public:
-		static void write(T*& t, pugi::xml_node& xml_node) {
-			if (t != S11N_NULLPTR)
-				xml_node.append_attribute("type").set_value(typeid(*t).name());
-		}
-	};
+	/// Value of raw type
+	template <class V>
+	void value(V value) {
+		writer_->attribute(value_name_, value);
+	}
 
-	pugi::xml_node xml() const { return xml_; }
+	void concept(const char* concept) {
+		writer_->attribute(dialect_->concept, concept);
+	}
+
+	/// Value of packed array
+	void base64(const void* data, size_t size) {
+		writer_->base64_attribute(value_name_, data, size);
+	}
+
+	/// Arrays of numbers are written as base64 of their bytes
+	bool packed() const { return packed_; }
+
+	XmlWriter* writer() const { return writer_; }
 
 	template <class T>
 	void ptr_impl(T* t) {
-		unsigned ref = 0;
-		if (t != S11N_NULLPTR) {
-			std::pair<bool, unsigned> set_result = refs_->set(t);
-			ref = set_result.second;
-			if (set_result.first) {
-				const Type* type = TypeStorageAccessor<XmlSerializerStorage>::find(typeid(*t).name());
-				if (type) { // If we found type in registered types, then initialize such way
-					PtrHolder node(this);
-					type->ctor->write(t, node);
-				}
-				else // Otherwise, no choise and direct way
-					OutputXmlSerializerCall<T&>::call(*t, *this);
-			}
+		if (t == S11N_NULLPTR) {
+			writer_->attribute(dialect_->ref, 0u);
+			return;
+		}
+		std::pair<bool, unsigned> set_result = Unshared<T>::value?
+			std::make_pair(true, refs_->next()) : refs_->set(t);
+		writer_->attribute(dialect_->ref, set_result.second);
+		if (!set_result.first)
+			return;
+		static S11N_THREAD_LOCAL TypeCache cache;
+		const Type* type = TypeStorageAccessor<XmlSerializerStorage>::find(typeid(*t), cache);
+		if (type) { // If we found type in registered types, then initialize such way
+			writer_->attribute(dialect_->type, type->key);
+			PtrHolder node(this);
+			type->ctor->write(t, node);
 		}
-		xml_.append_attribute("ref") = ref;
+		else // Otherwise, no choise and direct way
+			OutputXmlSerializerCall<T&>::call(*t, *this);
 	}
 
 	ReferencesPtr* refs() const { return refs_; }
 
 	OutputEssence essence() { return OutputEssence(); }
 
+	/// Object of type is written by this node
+	void begin_object(const std::type_info& info) {
+		type_ = &info;
+	}
+
+	/// Objects, which don't declare version, have version 0
+	void end_object() {
+		if (!declared_ && type_ != S11N_NULLPTR) {
+			bool implied = versions_->note(*type_, 0);
+			S11N_ASSERT(implied && "Type declares version in some objects only!");
+		}
+	}
+
 	unsigned format_version() {
 		return fmtver_;
 	}
 
+protected:
+	bool repeated(const char* name) const {
+		const bool found = writer_->has_attribute(name);
+		S11N_ASSERT(!found && "Field name is repeated in object!");
+		return found;
+	}
+
 protected:
 	OutputXmlSerializerNode* parent_;
 
-	pugi::xml_node xml_;
-	ReferencesPtr* refs_;
-	unsigned       version_;
-	unsigned       fmtver_;
+	XmlWriter*        writer_;
+	ReferencesPtr*    refs_;
+	XmlVersionTable*  versions_;
+	const XmlDialect* dialect_;
+	const char*       value_name_; /// Name of field for raw types written as attributes
+	const std::type_info* type_;
+	unsigned          version_;
+	bool              declared_;
+	unsigned          fmtver_;
+	bool              packed_;
 };
 
 template <class T>
@@ -125,7 +720,9 @@ public:
 		/*
 		 * Please implement `ser` method in your class.
 		 */
+		node.begin_object(typeid(T));
 		t.ser(node);
+		node.end_object();
 	}
 };
 
@@ -140,25 +737,364 @@ public:
 class OutputXmlSerializer : public OutputXmlSerializerNode {
 public:
 	OutputXmlSerializer(std::ostream& out) 
-	: 	OutputXmlSerializerNode(S11N_NULLPTR, pugi::xml_node(), &refs_),
-		out_(&out) {}
+	: 	OutputXmlSerializerNode(S11N_NULLPTR, &sink_, &refs_),
+		out_(&out),
+		sink_(&out),
+		record_mode_(false),
+		session_ids_(0) {
+		OutputXmlSerializerNode::versions_ = &versions_table_;
+	}
 
 	~OutputXmlSerializer() {}
 
 	template <class T>
 	OutputXmlSerializer& operator << (T& t) {
 		S11N_ASSERT(out_);
-		xml_ = doc_.append_child("serializable");
-		xml_.append_attribute("fmtver").set_value(fmtver_);
+		sink_.start("serializable");
+		sink_.attribute("fmtver", fmtver_);
 		static_cast<OutputXmlSerializer&>(*this & t);
-		xml_.print(*out_, "", pugi::format_raw);
+		versions_table_.flush(sink_);
+		sink_.end();
+		sink_.flush();
+		if (record_mode_ && refs_.issued() != session_ids_)
+			end_session();
 		return *this; 
 	}
 
+	/// Every record is written as independent one: objects of previous records are forgotten,
+	/// so memory stays flat however many records are written. Pinned objects are still shared
+	void record_mode(bool on) {
+		record_mode_ = on;
+	}
+
+	/// Writes vectors of numbers as base64 of their little-endian bytes
+	void packed(bool on) {
+		packed_ = on;
+	}
+
+	/// Switches to compact dialect. Must be called before first record
+	void compact(bool on) {
+		dialect_    = on? &XmlDialect::compact() : &XmlDialect::full();
+		value_name_ = dialect_->value;
+		fmtver_     = dialect_->fmtver;
+	}
+
+	/// Forgets written objects except pinned ones, so references tables don't grow in long streams
+	void end_session() {
+		S11N_ASSERT(out_);
+		std::vector<unsigned> kept = refs_.reset();
+		std::string pinned;
+		for (size_t i = 0; i < kept.size(); ++i) {
+			if (i != 0)
+				pinned += ' ';
+			char buf[16];
+			std::sprintf(buf, "%u", kept[i]);
+			pinned += buf;
+		}
+		sink_.start("session");
+		sink_.attribute("pinned", pinned.c_str());
+		sink_.end();
+		sink_.flush();
+		session_ids_ = refs_.issued();
+	}
+
 protected:
 	std::ostream*      out_;
+	XmlWriter          sink_;
 	ReferencesPtr      refs_;
-	pugi::xml_document doc_;
+	XmlVersionTable    versions_table_;
+	bool               record_mode_;
+	unsigned           session_ids_;
+};
+
+/// File contents in memory. With S11N_USE_MMAP file is mapped copy on write, 
+/// so parsing in place touches only private pages. Files, which aren't mapped 
+/// or can't be mapped, are read to owned buffer
+class XmlFileBlock {
+public:
+	explicit XmlFileBlock(const char* path, bool map = true)
+	:	data_(S11N_NULLPTR),
+		size_(0),
+		mapped_(false) {
+#if defined(S11N_USE_MMAP) && defined(_WIN32)
+		mapping_ = S11N_NULLPTR;
+		if (map) {
+			HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, S11N_NULLPTR, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, S11N_NULLPTR);
+			LARGE_INTEGER size;
+			if (file != INVALID_HANDLE_VALUE && GetFileSizeEx(file, &size) && size.QuadPart != 0) {
+				mapping_ = CreateFileMappingA(file, S11N_NULLPTR, PAGE_WRITECOPY, 0, 0, S11N_NULLPTR);
+				if (mapping_ != S11N_NULLPTR)
+					data_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0));
+				if (data_ != S11N_NULLPTR)
+					size_ = size_t(size.QuadPart);
+			}
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+		}
+#elif defined(S11N_USE_MMAP)
+		if (map) {
+			int file = ::open(path, O_RDONLY);
+			struct stat info;
+			if (file >= 0 && ::fstat(file, &info) == 0 && info.st_size != 0) {
+				void* data = ::mmap(S11N_NULLPTR, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+				if (data != MAP_FAILED) {
+					data_ = static_cast<char*>(data);
+					size_ = size_t(info.st_size);
+				}
+			}
+			if (file >= 0)
+				::close(file);
+		}
+#else
+		(void)map;
+#endif
+		mapped_ = data_ != S11N_NULLPTR;
+		if (!mapped_)
+			read(path);
+	}
+
+	~XmlFileBlock() {
+#if defined(S11N_USE_MMAP) && defined(_WIN32)
+		if (mapped_)
+			UnmapViewOfFile(data_);
+		if (mapping_ != S11N_NULLPTR)
+			CloseHandle(mapping_);
+#elif defined(S11N_USE_MMAP)
+		if (mapped_)
+			::munmap(data_, size_);
+#endif
+	}
+
+	char* data() const { return data_; }
+
+	size_t size() const { return data_ != S11N_NULLPTR? size_ : 0; }
+
+	/// File is mapped to memory, not read to buffer
+	bool mapped() const { return mapped_; }
+
+protected:
+	void read(const char* path) {
+		std::ifstream in(path, std::ios::binary);
+		S11N_ASSERT(in && "Can't open file!");
+		in.seekg(0, std::ios::end);
+		const std::streamoff size = in.tellg();
+		if (size > 0) {
+			buf_.resize(size_t(size));
+			in.seekg(0, std::ios::beg);
+			in.read(&buf_[0], size);
+			data_ = &buf_[0];
+			size_ = size_t(in.gcount());
+		}
+	}
+
+protected:
+	char*             data_;
+	size_t            size_;
+	bool              mapped_;
+	std::vector<char> buf_;
+#if defined(S11N_USE_MMAP) && defined(_WIN32)
+	HANDLE            mapping_;
+#endif
+
+private:
+	XmlFileBlock(const XmlFileBlock&);
+	XmlFileBlock& operator = (const XmlFileBlock&);
+};
+
+/// Cuts input to top level elements. Stream is read by chunks, so only one record is kept in memory. 
+/// Memory block is cut without copying. Record itself is parsed to full DOM, so its size is capped:
+/// larger record fails reader instead of growing memory
+class XmlRecordReader {
+public:
+	enum { CHUNK_SIZE = 64 * 1024, MAX_RECORD = 256 * 1024 * 1024 };
+
+	explicit XmlRecordReader(std::istream* in)
+	:	in_(in),
+		block_(S11N_NULLPTR),
+		block_size_(0),
+		end_(0),
+		max_record_(MAX_RECORD),
+		failed_(false) {}
+
+	XmlRecordReader(char* block, size_t size)
+	:	in_(S11N_NULLPTR),
+		block_(block),
+		block_size_(size),
+		end_(0),
+		max_record_(MAX_RECORD),
+		failed_(false) {}
+
+	/// Finds next top level element. Data is valid and may be modified until next call. 
+	/// Returns false at end of input, for truncated or too large record
+	bool next(char*& data, size_t& size) {
+		if (failed_)
+			return false;
+		size_t from = end_;
+		if (in_ != S11N_NULLPTR) {
+			buf_.erase(0, end_);
+			from = 0;
+		}
+		size_t pos = from, start = std::string::npos;
+		int depth = 0;
+		for (;;) {
+			pos = find(pos, "<");
+			if (pos == std::string::npos) {
+				pos = this->size();
+				if (!fill()) {
+					failed_ = true;
+					return false;
+				}
+				continue;
+			}
+			available(pos + 9);
+			const size_t end = markup_end(pos);
+			if (end == std::string::npos) {
+				failed_ = true; // Input is truncated or record is too large
+				return false;
+			}
+
+			const char kind = at(pos + 1);
+			if (kind == '/')
+				--depth;
+			else if (kind != '!' && kind != '?') {
+				if (depth == 0)
+					start = pos;
+				if (at(end - 2) != '/')
+					++depth;
+			}
+			pos = end;
+
+			if (depth == 0 && start != std::string::npos) {
+				data = this->data() + start;
+				size = pos - start;
+				end_ = pos;
+				failed_ = size > max_record_;
+				return !failed_;
+			}
+		}
+	}
+
+	/// Records larger than size fail reader. Stream buffer doesn't grow above it
+	void set_max_record(size_t size) { max_record_ = size; }
+
+	size_t max_record() const { return max_record_; }
+
+	/// Input is ended or truncated, or record is larger than maximal size
+	bool failed() const { return failed_; }
+
+protected:
+	char* data() {
+		return in_ != S11N_NULLPTR? &buf_[0] : block_;
+	}
+
+	size_t size() const {
+		return in_ != S11N_NULLPTR? buf_.size() : block_size_;
+	}
+
+	char at(size_t pos) {
+		return data()[pos];
+	}
+
+	size_t find(size_t from, const char* str) {
+		const size_t length = std::strlen(str);
+		const size_t size = this->size();
+		if (from >= size || size - from < length)
+			return std::string::npos;
+		const char* begin = data();
+		if (length == 1) {
+			const void* found = std::memchr(begin + from, str[0], size - from);
+			return found != S11N_NULLPTR? size_t(static_cast<const char*>(found) - begin) : std::string::npos;
+		}
+		const char* found = std::search(begin + from, begin + size, str, str + length);
+		return found != begin + size? size_t(found - begin) : std::string::npos;
+	}
+
+	/// Buffer keeps current record only, so it isn't filled above maximal record
+	bool fill() {
+		if (in_ == S11N_NULLPTR || buf_.size() > max_record_)
+			return false;
+		const size_t size = buf_.size();
+		buf_.resize(size + CHUNK_SIZE);
+		in_->read(&buf_[size], CHUNK_SIZE);
+		buf_.resize(size + size_t(in_->gcount()));
+		return buf_.size() != size;
+	}
+
+	void available(size_t size) {
+		while (this->size() < size && fill()) {}
+	}
+
+	bool starts(size_t pos, const char* prefix) {
+		const size_t length = std::strlen(prefix);
+		return pos + length <= size() && std::memcmp(data() + pos, prefix, length) == 0;
+	}
+
+	/// Position after markup, which starts at pos. Quoted '>' in attributes doesn't end tag
+	size_t markup_end(size_t pos) {
+		const char* terminator = S11N_NULLPTR;
+		if (starts(pos, "<!--"))
+			terminator = "-->";
+		else if (starts(pos, "<![CDATA["))
+			terminator = "]]>";
+		else if (starts(pos, "<?"))
+			terminator = "?>";
+
+		if (terminator != S11N_NULLPTR) {
+			const size_t length = std::strlen(terminator);
+			for (size_t from = pos + 2;;) {
+				const size_t found = find(from, terminator);
+				if (found != std::string::npos)
+					return found + length;
+				if (size() >= length)
+					from = std::max(from, size() - length + 1);
+				if (!fill())
+					return std::string::npos;
+			}
+		}
+
+		char quote = 0;
+		for (size_t i = pos + 1;; ++i) {
+			if (i == size() && !fill())
+				return std::string::npos;
+			const char ch = at(i);
+			if (quote != 0) {
+				if (ch == quote)
+					quote = 0;
+			}
+			else if (ch == '"' || ch == '\'')
+				quote = ch;
+			else if (ch == '>')
+				return i + 1;
+		}
+	}
+
+	std::istream* in_;
+	std::string   buf_;
+	char*         block_;
+	size_t        block_size_;
+	size_t        end_;
+	size_t        max_record_;
+	bool          failed_;
+};
+
+/// Field value decoded by search() for constructor. named() takes it instead of decoding again.
+/// Name is copied, because caller may pass buffer, which doesn't live until named()
+class XmlSearched {
+public:
+	XmlSearched(const char* name, const std::type_info& info) : name(name), info(&info) {}
+
+	virtual ~XmlSearched() {}
+
+	std::string           name;
+	const std::type_info* info;
+};
+
+template <class T>
+class XmlSearchedValue : public XmlSearched {
+public:
+	XmlSearchedValue(const char* name, const T& value) : XmlSearched(name, typeid(T)), value(value) {}
+
+	T value;
 };
 
 class InputXmlSerializerNode {
@@ -167,8 +1103,16 @@ public:
 	:	parent_(parent),
 		xml_(node),
 		refs_(refs),
+		versions_(parent? parent->versions_ : S11N_NULLPTR),
+		dialect_(parent? parent->dialect_ : &XmlDialect::full()),
+		value_name_(dialect_->value),
 		version_(0) {}
 
+	~InputXmlSerializerNode() {
+		for (size_t i = 0; i < searched_.size(); ++i)
+			delete searched_[i];
+	}
+
 	void decl_version(unsigned ver) {}
 
 	unsigned version() const {
@@ -187,11 +1131,11 @@ public:
 
 	template <class T>
 	InputXmlSerializerNode& named(T& t, const char* attr_name) {
-		make_call(t, next_child_node());
-		// TODO: Check attr_name
-		// TODO: Miss this if we've read this earlier (in search, for example)
-		version_ = xml_.attribute("ver").as_int();
-
+		if (read_inlined(t, attr_name))
+			return *this;
+		pugi::xml_node child = next_child_node();
+		if (!take_searched(t, attr_name))
+			make_call(t, child);
 		return *this;
 	}
 
@@ -199,56 +1143,84 @@ public:
 	void optional(T& t, const char* name, const T& def)
 	{
 		S11N_ASSERT(name && name[0] != '\0');
-		pugi::xml_node found = xml_.find_child_by_attribute("name", name);
-		if (!found.empty())
-			make_call(t, found);
+		if (read_inlined(t, name))
+			return;
+		bool ahead = false;
+		pugi::xml_node found = find_named(name, cur_child_, ahead);
+		if (!found.empty()) {
+			if (ahead) // Following fields are after this one
+				cur_child_ = found;
+			if (!take_searched(t, name))
+				make_call(t, found);
+		}
 		else
 			t = def;
 	}
 
 	template <class T>
 	bool search(T& t, const char* attr_name) {
-		pugi::xml_node found = xml_.find_child_by_attribute("name", attr_name);
+		if (read_inlined(t, attr_name))
+			return true;
+		bool ahead = false;
+		pugi::xml_node found = find_named(attr_name, search_child_, ahead);
 		S11N_ASSERT(!found.empty());
+		search_child_ = found;
 		make_call(t, found);
+		remember(t, attr_name);
 		return true;
 	}
 
 	void set_xml(pugi::xml_node& xml) { 
-		xml_       = xml;
-		cur_child_ = pugi::xml_node();
+		xml_          = xml;
+		cur_child_    = pugi::xml_node();
+		search_child_ = pugi::xml_node();
+		named_.clear();
 	}
 
 	pugi::xml_node xml() const { return xml_; }
 
+	/// Value of raw type
+	pugi::xml_attribute value() const {
+		return xml_.attribute(value_name_);
+	}
+
+	const char* concept() const {
+		return xml_.attribute(dialect_->concept).as_string();
+	}
+
 	template <class T>
 	void ptr_impl(T*& t) {
-		pugi::xml_attribute ref_attr = xml_.attribute("ref");
+		pugi::xml_attribute ref_attr = xml_.attribute(dialect_->ref);
 		S11N_ASSERT(ref_attr);
 		unsigned ref = ref_attr.as_uint();
-		if (ref != 0) {
-			void* ptr = refs_->get(ref);
-			if (ptr == S11N_NULLPTR) {
-				pugi::xml_attribute type_attr = xml_.attribute("type");
-				bool from_ctor = true;
-				if (type_attr) {
-					const Type* type = TypeStorageAccessor<XmlSerializerStorage>::find(type_attr.as_string());
-					if (type != S11N_NULLPTR) {
-						from_ctor = false;
-						PtrHolder node_holder(this);
-						PtrHolder got = type->ctor->create(node_holder);
-						t = got.get<T>(); // TODO: Fixme another template adapter
-						type->ctor->read(t, node_holder);
-					}
-				}
-				
-				if (from_ctor) {
-					t = Ctor<T*, InputXmlSerializerNode>::ctor(*this);
-					make_call(*t, xml_);
-				}
-				
+		if (ref == 0 || !refs_->accept(ref)) {
+			S11N_ASSERT(ref == 0 && "Invalid reference!");
+			t = S11N_NULLPTR;
+			return;
+		}
+
+		void* ptr = Unshared<T>::value? S11N_NULLPTR : refs_->get(ref);
+		if (ptr != S11N_NULLPTR) {
+			t = static_cast<T*>(ptr);
+			return;
+		}
+
+		// Object is known by id before its fields are read, so cycles point to it
+		pugi::xml_attribute type_attr = xml_.attribute(dialect_->type);
+		const Type* type = type_attr? find_type(type_attr.as_string()) : S11N_NULLPTR;
+		if (type != S11N_NULLPTR) {
+			PtrHolder node_holder(this);
+			PtrHolder got = type->ctor->create(node_holder);
+			t = got.get<T>(); // TODO: Fixme another template adapter
+			if (!Unshared<T>::value)
 				refs_->set(ref, t);
-			}
+			type->ctor->read(t, node_holder);
+		}
+		else { // The same node, so fields searched by constructor aren't decoded again
+			t = Ctor<T*, InputXmlSerializerNode>::ctor(*this);
+			if (!Unshared<T>::value)
+				refs_->set(ref, t);
+			InputXmlSerializerCall<T&>::call(*t, *this);
 		}
 	}
 
@@ -256,7 +1228,116 @@ public:
 
 	InputEssence essence() { return InputEssence(); }
 
+	/// Takes version of object, or version of its type from stream table
+	void load_version(const std::type_info& info, XmlVersionCache& cache) {
+		pugi::xml_attribute ver = xml_.attribute("ver");
+		version_ = !ver.empty()? ver.as_uint() : versions_->find(info, cache);
+	}
+
+	/// Type by key. Type names are read from older streams
+	static const Type* find_type(const char* type) {
+		char* end = S11N_NULLPTR;
+		unsigned long key = std::strtoul(type, &end, 10);
+		if (end != type && *end == '\0') {
+			static S11N_THREAD_LOCAL TypeCache cache;
+			return TypeStorageAccessor<XmlSerializerStorage>::find_key(unsigned(key), cache);
+		}
+		return TypeStorageAccessor<XmlSerializerStorage>::find(type);
+	}
+
 protected:
+	/// Named field of raw type, which is attribute of this object in compact dialect
+	template <class T>
+	bool read_inlined(T& t, const char* name) {
+		if (!XmlRaw<T>::value || !dialect_->inlined(name) || xml_.attribute(name).empty())
+			return false;
+		InputXmlSerializerNode node(this, xml_, refs_);
+		node.value_name_ = name;
+		InputXmlSerializerCall<T&>::call(t, node);
+		return true;
+	}
+
+	template <class T>
+	void remember(const T& t, const char* name) {
+		if (take_searched(name, typeid(T)) == S11N_NULLPTR) // Searched twice
+			searched_.push_back(new XmlSearchedValue<T>(name, t));
+	}
+
+	/// Objects are created by search() itself, and named() creates its own ones
+	template <class T>
+	void remember(T* const&, const char*) {}
+
+	/// Arrays aren't assignable, so they are decoded again
+	template <class T, int Size>
+	void remember(const T(&)[Size], const char*) {}
+
+	template <class T, int Size>
+	bool take_searched(T(&)[Size], const char*) {
+		return false;
+	}
+
+	template <class T>
+	bool take_searched(T& t, const char* name) {
+		if (searched_.empty() || name == S11N_NULLPTR || name[0] == '\0')
+			return false;
+		XmlSearched* found = take_searched(name, typeid(T));
+		if (found == S11N_NULLPTR)
+			return false;
+		t = S11N_MOVE(static_cast<XmlSearchedValue<T>*>(found)->value);
+		delete found;
+		return true;
+	}
+
+	XmlSearched* take_searched(const char* name, const std::type_info& info) {
+		for (size_t i = 0; i < searched_.size(); ++i) {
+			if (*searched_[i]->info == info && searched_[i]->name == name) {
+				XmlSearched* found = searched_[i];
+				searched_.erase(searched_.begin() + i);
+				return found;
+			}
+		}
+		return S11N_NULLPTR;
+	}
+
+	/// Child with name. Next sibling of cursor is checked first, so fields, which are looked up
+	/// in order of writing, are found at once. Others are found in index of children, which is
+	/// built on first miss. Search starts after cursor and wraps around
+	pugi::xml_node find_named(const char* name, pugi::xml_node cursor, bool& ahead) {
+		pugi::xml_node next = cursor.empty()? xml_.first_child() : cursor.next_sibling();
+		if (!next.empty() && std::strcmp(next.attribute(dialect_->name).value(), name) == 0) {
+			ahead = true;
+			return next;
+		}
+
+		if (named_.empty()) {
+			size_t pos = 0;
+			for (pugi::xml_node child = xml_.first_child(); child; child = child.next_sibling())
+				named_.push_back(NamedChild(child.attribute(dialect_->name).value(), pos++, child));
+			std::sort(named_.begin(), named_.end());
+		}
+
+		const size_t from = cursor.empty()? 0 : position(cursor) + 1;
+		std::vector<NamedChild>::const_iterator found = 
+			std::lower_bound(named_.begin(), named_.end(), NamedChild(name, from, pugi::xml_node()));
+		if (found != named_.end() && std::strcmp(found->name, name) == 0) {
+			ahead = true;
+			return found->node;
+		}
+		found = std::lower_bound(named_.begin(), named_.end(), NamedChild(name, 0, pugi::xml_node()));
+		if (found != named_.end() && std::strcmp(found->name, name) == 0)
+			return found->node;
+		return pugi::xml_node();
+	}
+
+	/// Number of child in index
+	size_t position(pugi::xml_node child) const {
+		std::vector<NamedChild>::const_iterator i = std::lower_bound(named_.begin(), named_.end(), 
+			NamedChild(child.attribute(dialect_->name).value(), 0, pugi::xml_node()));
+		for (; i != named_.end() && i->node != child; ++i) {}
+		S11N_ASSERT(i != named_.end());
+		return i->pos;
+	}
+
 	pugi::xml_node next_child_node() {
 		return cur_child_ = cur_child_.empty() ? 
 			*xml_.begin() : cur_child_.next_sibling();
@@ -271,11 +1352,34 @@ protected:
 protected:
 	InputXmlSerializerNode* parent_;
 	ReferencesId*           refs_;
+	XmlVersionTable*        versions_;
+	const XmlDialect*       dialect_;
+	const char*             value_name_;
 	unsigned                version_;
 
 private:
+	/// Child in index, which is sorted by names and then by positions
+	struct NamedChild {
+		NamedChild(const char* name, size_t pos, pugi::xml_node node) : name(name), pos(pos), node(node) {}
+
+		bool operator < (const NamedChild& other) const {
+			const int cmp = std::strcmp(name, other.name);
+			return cmp < 0 || (cmp == 0 && pos < other.pos);
+		}
+
+		const char*    name;
+		size_t         pos;
+		pugi::xml_node node;
+	};
+
 	pugi::xml_node          xml_;
 	pugi::xml_node          cur_child_;
+	pugi::xml_node          search_child_;
+	std::vector<XmlSearched*> searched_;
+	std::vector<NamedChild> named_;
+
+	InputXmlSerializerNode(const InputXmlSerializerNode&);
+	InputXmlSerializerNode& operator = (const InputXmlSerializerNode&);
 };
 
 template <class T>
@@ -285,6 +1389,8 @@ public:
 		/*
 		 * Please implement `ser` method in your class.
 		 */
+		static S11N_THREAD_LOCAL XmlVersionCache cache;
+		node.load_version(typeid(T), cache);
 		t.ser(node);
 	}
 };
@@ -301,43 +1407,117 @@ class InputXmlSerializer : public InputXmlSerializerNode {
 public:
 	InputXmlSerializer(std::istream& in)
 	: 	InputXmlSerializerNode(S11N_NULLPTR, pugi::xml_node(), &refs_),
-		in_(&in) {
-		pugi::xml_parse_result result = doc_.load(*in_);
+		in_(&in),
+		file_(S11N_NULLPTR),
+		records_(&in) {
+		InputXmlSerializerNode::versions_ = &versions_table_;
 	}
 
+	/// Reads file, which is parsed in place. File is mapped, if map is set and S11N_USE_MMAP is defined,
+	/// otherwise it's read to buffer. See XmlFileBlock
+	explicit InputXmlSerializer(const char* path, bool map = true)
+	: 	InputXmlSerializerNode(S11N_NULLPTR, pugi::xml_node(), &refs_),
+		in_(S11N_NULLPTR),
+		file_(new XmlFileBlock(path, map)),
+		records_(file_->data(), file_->size()) {
+		InputXmlSerializerNode::versions_ = &versions_table_;
+	}
+
+	/// Reads memory block in place. Parsing modifies block, which must live while serializer reads
+	InputXmlSerializer(char* data, size_t size)
+	: 	InputXmlSerializerNode(S11N_NULLPTR, pugi::xml_node(), &refs_),
+		in_(S11N_NULLPTR),
+		file_(S11N_NULLPTR),
+		records_(data, size) {
+		InputXmlSerializerNode::versions_ = &versions_table_;
+	}
+
+	~InputXmlSerializer() {
+		doc_.reset();
+		delete file_;
+	}
+
+	/// Object is left as is, if input is ended or record can't be read
 	template <class T>
 	InputXmlSerializer& operator >> (T& t) {
-		next_serializable();
-		return static_cast<InputXmlSerializer&>(*this & t);
+		if (next_serializable())
+			*this & t;
+		return *this;
+	}
+
+	/// Records larger than size aren't read. See XmlRecordReader::MAX_RECORD
+	void set_max_record(size_t size) {
+		records_.set_max_record(size);
+	}
+
+	/// Input is ended or truncated, or record is too large. Objects aren't read after that
+	bool failed() const {
+		return records_.failed();
 	}
 
 protected:
-	void next_serializable() {
-		pugi::xml_node next = xml().empty()?
-			doc_.child("serializable") : xml().next_sibling();
+	/// Parses next record only, previous one is freed. False at end of input
+	bool next_serializable() {
+		pugi::xml_node next;
+		do {
+			char* data = S11N_NULLPTR;
+			size_t size = 0;
+			if (!records_.next(data, size)) {
+				doc_.reset();
+				set_xml(next);
+				return false;
+			}
+			// Strings of document point to record, and only attributes with escapes are read
+			doc_.load_buffer_inplace(data, size, pugi::parse_minimal | pugi::parse_escapes, pugi::encoding_utf8);
+			next = doc_.first_child();
+			if (std::strcmp(next.name(), "session") == 0)
+				start_session(next);
+		} while (std::strcmp(next.name(), "session") == 0);
+		versions_table_.load(next);
+		dialect_    = &XmlDialect::of(next.attribute("fmtver").as_uint());
+		value_name_ = dialect_->value;
 		set_xml(next);
+		return true;
+	}
+
+	void start_session(pugi::xml_node session) {
+		std::vector<unsigned> kept;
+		const char* pinned = session.attribute("pinned").as_string();
+		char* end = S11N_NULLPTR;
+		for (unsigned long id = std::strtoul(pinned, &end, 10); end != pinned; id = std::strtoul(pinned, &end, 10)) {
+			kept.push_back(unsigned(id));
+			pinned = end;
+		}
+		refs_.reset(kept);
 	}
 
 protected:
 	std::istream*      in_;
+	XmlFileBlock*      file_;
+	XmlRecordReader    records_;
 	ReferencesId       refs_;
+	XmlVersionTable    versions_table_;
 	pugi::xml_document doc_;
 };
 
 #define SN_RAW(Type, Retrieve) \
+	template <>\
+	struct XmlRaw<Type> {\
+		enum { value = 1 };\
+	};\
 	template <>\
 	class OutputXmlSerializerCall<Type&> {\
 	public:\
 		static void call(Type& t, OutputXmlSerializerNode& node) {\
-			node.xml().append_attribute("value") = t;\
+			node.value(t);\
 		}\
 	};\
 	template <>\
 	class InputXmlSerializerCall<Type&> {\
 	public:\
 		static void call(Type& t, InputXmlSerializerNode& node) {\
-			pugi::xml_attribute attr = node.xml().attribute("value");\
-			t = static_cast<Type>(attr.Retrieve());\
+			pugi::xml_attribute attr = node.value();\
+			t = static_cast<Type>(XmlNumber::Retrieve(attr.value()));\
 		}\
 	};
 
@@ -383,13 +1563,17 @@ public:
 	class OutputXmlSerializerCall<Type&> {\
 	public:\
 		static void call(Type& t, OutputXmlSerializerNode& node) {\
+			node.begin_object(typeid(Type));\
 			Function(t, node);\
+			node.end_object();\
 		}\
 	};\
 	template <>\
 	class InputXmlSerializerCall<Type&> {\
 	public:\
 		static void call(Type& t, InputXmlSerializerNode& node) {\
+			static S11N_THREAD_LOCAL XmlVersionCache cache;\
+			node.load_version(typeid(Type), cache);\
 			Function(t, node);\
 		}\
 	};
@@ -398,14 +1582,14 @@ template <int Size>
 class OutputXmlSerializerCall<char(&)[Size]> {
 public:
 	static void call(char(&t)[Size], OutputXmlSerializerNode& node) {
-		node.xml().append_attribute("value").set_value(t);
+		node.value(static_cast<const char*>(t));
 	}
 };
 template <int Size>
 class InputXmlSerializerCall<char(&)[Size]> {
 public:
 	static void call(char(&t)[Size], InputXmlSerializerNode& node) {
-		pugi::xml_attribute attr = node.xml().attribute("value");
+		pugi::xml_attribute attr = node.value();
 		S11N_ASSERT(attr);
 		const pugi::char_t* orig = attr.as_string();
 		size_t size = strlen(orig);
@@ -7,12 +7,39 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <deque>
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <cstdint>
+#include <typeinfo>
 
 #ifdef S11N_CPP03
 #	define S11N_NULLPTR NULL
 #else
 #	define S11N_NULLPTR nullptr
+#	include <unordered_map>
+#	include <atomic>
+#	include <mutex>
+#endif
+
+#ifdef S11N_CPP03
+#	define S11N_THREAD_LOCAL
+#	define S11N_REGISTRY_LOCK(Mutex)
+#else
+#	define S11N_THREAD_LOCAL thread_local
+#	define S11N_REGISTRY_LOCK(Mutex) std::lock_guard<std::mutex> lock(Mutex)
+#endif
+
+#ifdef S11N_CPP03
+#	define S11N_MOVE(Value) (Value)
+#else
+#	include <utility>
+#	define S11N_MOVE(Value) std::move(Value)
+#endif
+
+#if !defined(S11N_CPP17) && (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#	define S11N_CPP17
 #endif
 
 #ifdef _MSC_VER
@@ -59,84 +86,281 @@ public:
         return info_->name();
     }
 
+	const std::type_info& info() const {
+		return *info_;
+	}
+
 protected:
 	const std::type_info* info_;
 };
 
+/// Hashing of type names without building strings
+struct CStrHash {
+	size_t operator () (const char* str) const {
+		size_t hash = 2166136261u; // FNV-1a
+		for (; *str; ++str)
+			hash = (hash ^ static_cast<unsigned char>(*str)) * 16777619u;
+		return hash;
+	}
+};
+
+struct CStrLess {
+	bool operator () (const char* a, const char* b) const {
+		return std::strcmp(a, b) < 0;
+	}
+};
+
+struct CStrEqual {
+	bool operator () (const char* a, const char* b) const {
+		return std::strcmp(a, b) == 0;
+	}
+};
+
+#ifndef S11N_CPP03
+struct TypeIndexHash {
+	size_t operator () (const TypeIndex& index) const {
+		return index.info().hash_code();
+	}
+};
+#endif
+
+/// Version of protocol shared by several types. Writer declares it, reader gets it from stream
 class ProtocolVersion {
 public:
+	explicit ProtocolVersion(unsigned version = 0) : version_(version) {}
 
 	template <class Node>
 	void setup(Node& node) {
 		setup_impl(node, node.essence());
 	}
 
+	unsigned version() const {
+		return version_;
+	}
+
 private:
 	template <class Node>
-	void setup(Node& node, InputEssence&) {
+	void setup_impl(Node& node, InputEssence&) {
+		node.decl_version(version_); // Formats without versions in stream keep declared one
 		version_ = node.version();
 	}
 
 	template <class Node>
-	void setup(Node& node, OutputEssence&) {
-		node.version(version_);
+	void setup_impl(Node& node, OutputEssence&) {
+		node.decl_version(version_);
+	}
+
+	template <class Node>
+	void setup_impl(Node& node, ConstructEssence&) {
+		node.decl_version(version_);
 	}
 
 private:
 	unsigned version_;
 };
 
-/// Dictionary for integer id to object pointers 
+/// Dictionary for integer id to object pointers. Ids are given densely from 1, so it's a plain array
 class ReferencesId {
 public:
-	typedef std::map<unsigned, void*>                 RefMap;
-	typedef std::map<unsigned, void*>::const_iterator RefMapCIter;
+	/// Ids of unshared objects aren't kept, so ids may skip a little. Larger gaps are corrupted stream
+	static const unsigned MAX_GAP = 1024;
 
-	ReferencesId() {}
+	explicit ReferencesId(size_t size_hint = 0) : top_(0) {
+		reserve(size_hint);
+	}
 
 	void* get(unsigned key) const {
-		RefMapCIter found = refs_.find(key);
-		return found != refs_.end()? found->second : S11N_NULLPTR;
+		return key < refs_.size()? refs_[key] : S11N_NULLPTR;
+	}
+
+	/// Checks id read from stream. False for ids far above ones read before
+	bool accept(uint64_t key) {
+		if (key > uint64_t(top_) + MAX_GAP)
+			return false;
+		top_ = std::max(top_, unsigned(key));
+		return true;
 	}
 
 	void set(unsigned key, void* val) {
-		refs_.insert(std::make_pair(key, val));
+		if (!accept(key)) {
+			S11N_ASSERT(0 && "Invalid reference!");
+			return;
+		}
+		if (key >= refs_.size())
+			refs_.resize(std::max<size_t>(key + 1, refs_.size() * 2), S11N_NULLPTR);
+		if (refs_[key] == S11N_NULLPTR)
+			refs_[key] = val;
 	}
 
+	/// Preallocating for expected number of objects
+	void reserve(size_t size) {
+		refs_.reserve(size + 1);
+	}
+
+	/// Starts new session: forgets objects except kept ones, which get ids from 1 in order
+	void reset(const std::vector<unsigned>& kept) {
+		std::vector<void*> refs(kept.size() + 1, S11N_NULLPTR);
+		for (size_t i = 0; i < kept.size(); ++i)
+			refs[i + 1] = get(kept[i]);
+
+#ifndef S11N_CPP03
+		OwnerMap owners;
+		for (size_t i = 1; i < refs.size(); ++i) {
+			OwnerMap::const_iterator found = owners_.find(refs[i]);
+			if (found != owners_.end())
+				owners.insert(*found);
+		}
+		owners_.swap(owners);
+#endif
+		refs_.swap(refs);
+		top_ = unsigned(kept.size());
+	}
+
+#ifndef S11N_CPP03
+	/// Owner of shared object, so every std::shared_ptr to it shares ownership
+	std::shared_ptr<void> owner(void* ptr) const {
+		OwnerMap::const_iterator found = owners_.find(ptr);
+		return found != owners_.end()? found->second.lock() : std::shared_ptr<void>();
+	}
+
+	void set_owner(void* ptr, const std::shared_ptr<void>& owner) {
+		owners_[ptr] = owner;
+	}
+#endif
+
 protected:
-	RefMap refs_;
+	std::vector<void*> refs_;
+	unsigned           top_; /// Largest id read in session
+
+#ifndef S11N_CPP03
+	typedef std::map<void*, std::weak_ptr<void> > OwnerMap;
+	OwnerMap owners_;
+#endif
 };
 
-/// Mapping for object pointers to integer id
+/// Mapping for object pointers to integer id. Open addressing table with linear probing
 class ReferencesPtr {
 public:
-	typedef std::map<void*, unsigned>                 RefMap;
-	typedef std::map<void*, unsigned>::const_iterator RefMapCIter;
-
-	ReferencesPtr() : id_(1) {}
+	explicit ReferencesPtr(size_t size_hint = 0) : id_(1), size_(0) {
+		reserve(size_hint);
+	}
 
 	unsigned get(void* key) const {
-		RefMapCIter found = refs_.find(key);
-		return found != refs_.end()? found->second : 0;
+		if (slots_.empty())
+			return 0;
+		const Slot& slot = slots_[lookup(key)];
+		return slot.key == key? slot.id : 0;
 	}
 
 	template <typename T>
-	std::pair<bool, unsigned> set(T* key) {
-		unsigned id   = get(key);
-		bool inserted = false;
-
-		if (id == 0) {
-			id = id_++;
-			refs_.insert(std::make_pair(key, id));
-			inserted = true;
+	std::pair<bool, unsigned> set(T* ptr) {
+		void* key = const_cast<void*>(static_cast<const void*>(ptr));
+		S11N_ASSERT(key != S11N_NULLPTR);
+		if ((size_ + 1) * 2 > slots_.size())
+			rehash(std::max<size_t>(slots_.size() * 2, 16));
+
+		Slot& slot = slots_[lookup(key)];
+		if (slot.key == key)
+			return std::make_pair(false, slot.id);
+
+		slot.key = key;
+		slot.id  = id_++;
+		++size_;
+		return std::make_pair(true, slot.id);
+	}
+
+	/// Id for object, which isn't tracked
+	unsigned next() {
+		return id_++;
+	}
+
+	/// Number of ids given in current session
+	unsigned issued() const {
+		return id_ - 1;
+	}
+
+	/// Pinned objects live through sessions
+	template <typename T>
+	void pin(T* ptr) {
+		void* key = const_cast<void*>(static_cast<const void*>(ptr));
+		if (std::find(pinned_.begin(), pinned_.end(), key) == pinned_.end())
+			pinned_.push_back(key);
+	}
+
+	template <typename T>
+	void unpin(T* ptr) {
+		void* key = const_cast<void*>(static_cast<const void*>(ptr));
+		pinned_.erase(std::remove(pinned_.begin(), pinned_.end(), key), pinned_.end());
+	}
+
+	/// Starts new session: forgets objects except pinned ones, which get ids from 1 in order. 
+	/// Returns their previous ids for ReferencesId::reset on reading side
+	std::vector<unsigned> reset() {
+		std::vector<unsigned> kept;
+		std::vector<void*>    keys;
+		for (size_t i = 0; i < pinned_.size(); ++i) {
+			unsigned id = get(pinned_[i]);
+			if (id != 0) { // Pinned objects, which aren't written yet, wait for next session
+				kept.push_back(id);
+				keys.push_back(pinned_[i]);
+			}
 		}
-			
-		return std::make_pair(inserted, id);
+
+		std::fill(slots_.begin(), slots_.end(), Slot());
+		size_ = 0;
+		id_   = 1;
+		for (size_t i = 0; i < keys.size(); ++i)
+			set(keys[i]);
+		return kept;
+	}
+
+	/// Preallocating for expected number of objects
+	void reserve(size_t size) {
+		size_t capacity = 16;
+		while (capacity < size * 2)
+			capacity *= 2;
+		if (capacity > slots_.size())
+			rehash(capacity);
 	}
 
 protected:
-	RefMap refs_;
-	unsigned id_;
+	struct Slot {
+		void*    key; /// Null for empty slot
+		unsigned id;
+
+		Slot() : key(S11N_NULLPTR), id(0) {}
+	};
+
+	/// Slot with key or first empty slot on the way
+	size_t lookup(void* key) const {
+		size_t mask = slots_.size() - 1;
+		size_t i = hash(key) & mask;
+		while (slots_[i].key != S11N_NULLPTR && slots_[i].key != key)
+			i = (i + 1) & mask;
+		return i;
+	}
+
+	static size_t hash(void* key) {
+		size_t h = reinterpret_cast<size_t>(key);
+		h ^= h >> 16;
+		h *= 0x45d9f3bu;
+		h ^= h >> 16;
+		return h;
+	}
+
+	void rehash(size_t capacity) {
+		std::vector<Slot> old(capacity);
+		old.swap(slots_);
+		for (size_t i = 0; i < old.size(); ++i) {
+			if (old[i].key != S11N_NULLPTR)
+				slots_[lookup(old[i].key)] = old[i];
+		}
+	}
+
+	std::vector<Slot>  slots_;
+	unsigned           id_;
+	size_t             size_;
+	std::vector<void*> pinned_;
 };
 
 class BasePlant;
@@ -147,17 +371,219 @@ struct Type {
 	BasePlant*         ctor; /// Constructing plant 
 	std::vector<Type*> base; /// Base classes
 	std::string        alias;
+	unsigned           id;   /// Number in order of registration, starting from 1
+	unsigned           key;  /// Number written to streams: hash of alias or number of registration
 
 	Type(const TypeIndex& info)
-	:	info(info), ctor(S11N_NULLPTR) {}
+	:	info(info), ctor(S11N_NULLPTR), id(0), key(0) {}
+
+	/// Keys of aliases have high bit, so they never meet numbers of registration
+	static const unsigned ALIAS_KEY = 0x80000000u;
+
+	/// FNV-1a of alias. Same on every compiler and platform, so keys are stable
+	static unsigned alias_key(const std::string& alias) {
+		unsigned long hash = 2166136261ul;
+		for (size_t i = 0; i < alias.size(); ++i)
+			hash = ((hash ^ static_cast<unsigned char>(alias[i])) * 16777619ul) & 0xFFFFFFFFul;
+		return unsigned(hash) | ALIAS_KEY;
+	}
+};
+
+/// Registered types with hashed indices by type, type name and alias. Types live in registry
+class TypeSnapshot {
+public:
+	typedef std::vector<const Type*>::const_iterator const_iterator;
+
+	void add(const Type* type) {
+		size_t index = types_.size();
+		types_.push_back(type);
+		by_info_.insert(std::make_pair(type->info, index));
+		by_name_.insert(std::make_pair(type->info.name(), index));
+		if (!type->alias.empty()) {
+			by_alias_.insert(std::make_pair(type->alias, index));
+			S11N_ASSERT(by_key_.find(type->key) == by_key_.end() && "Aliases have same keys!");
+			by_key_.insert(std::make_pair(type->key, index));
+		}
+	}
+
+	/// Type by key from stream
+	const Type* find_key(unsigned key) const {
+		if ((key & Type::ALIAS_KEY) == 0)
+			return key != 0? at(key - 1) : S11N_NULLPTR;
+		KeyMap::const_iterator found = by_key_.find(key);
+		return found != by_key_.end()? types_[found->second] : S11N_NULLPTR;
+	}
+
+	const Type* find(const TypeIndex& info) const {
+		InfoMap::const_iterator found = by_info_.find(info);
+		return found != by_info_.end()? types_[found->second] : S11N_NULLPTR;
+	}
+
+	/// Type by name of type or by alias
+	const Type* find(const char* name) const {
+		NameMap::const_iterator found = by_name_.find(name);
+		if (found != by_name_.end())
+			return types_[found->second];
+		if (by_alias_.empty())
+			return S11N_NULLPTR;
+		AliasMap::const_iterator alias = by_alias_.find(name);
+		return alias != by_alias_.end()? types_[alias->second] : S11N_NULLPTR;
+	}
+
+	const Type* at(size_t index) const {
+		return index < types_.size()? types_[index] : S11N_NULLPTR;
+	}
+
+	size_t size() const { return types_.size(); }
+
+	const_iterator begin() const { return types_.begin(); }
+
+	const_iterator end() const { return types_.end(); }
+
+protected:
+#ifdef S11N_CPP03
+	typedef std::map<TypeIndex, size_t>                             InfoMap;
+	typedef std::map<const char*, size_t, CStrLess>                 NameMap;
+	typedef std::map<std::string, size_t>                           AliasMap;
+	typedef std::map<unsigned, size_t>                              KeyMap;
+#else
+	typedef std::unordered_map<TypeIndex, size_t, TypeIndexHash>    InfoMap;
+	typedef std::unordered_map<const char*, size_t, CStrHash, CStrEqual> NameMap;
+	typedef std::unordered_map<std::string, size_t>                 AliasMap;
+	typedef std::unordered_map<unsigned, size_t>                    KeyMap;
+#endif
+
+	std::vector<const Type*> types_;
+	InfoMap           by_info_;
+	NameMap           by_name_; /// Keys are names from std::type_info, so they live forever
+	AliasMap          by_alias_;
+	KeyMap            by_key_;
+};
+
+/// Registration publishes new immutable snapshot of types, so lookups are lock-free reads 
+/// from any thread, which share nothing written. Replaced snapshots are kept until registry
+/// is destroyed, because lookup may still run in them. Registration happens at startup,
+/// so they are few. Types aren't copied to snapshots and live as long as registry,
+/// so found types stay valid
+class TypeRegistry {
+public:
+	TypeRegistry() : current_(new TypeSnapshot), generation_(1) {}
+
+	~TypeRegistry() {
+		delete current();
+		free_retired();
+	}
+
+	/// Checks, that type, alias and key of alias are new, and adds type in one step.
+	/// False for registered ones and for aliases with the same hash as registered alias
+	bool add(const Type& type) {
+		S11N_REGISTRY_LOCK(mutex_);
+		const TypeSnapshot& now = *current();
+		if (now.find(type.info) != S11N_NULLPTR)
+			return false;
+		if (!type.alias.empty() && (now.find(type.alias.c_str()) != S11N_NULLPTR 
+			|| now.find_key(Type::alias_key(type.alias)) != S11N_NULLPTR))
+			return false;
+
+		types_.push_back(type);
+		Type& added = types_.back();
+		added.id  = unsigned(now.size() + 1);
+		added.key = added.alias.empty()? added.id : Type::alias_key(added.alias);
+		TypeSnapshot* next = new TypeSnapshot(now);
+		next->add(&added);
+		publish(next);
+		return true;
+	}
+
+	void clear() {
+		S11N_REGISTRY_LOCK(mutex_);
+		publish(new TypeSnapshot);
+	}
+
+	/// Registered types in order of registration
+	std::vector<const Type*> types() const {
+		S11N_REGISTRY_LOCK(mutex_);
+		const TypeSnapshot& now = *current();
+		return std::vector<const Type*>(now.begin(), now.end());
+	}
+
+	const Type* find(const TypeIndex& info) const { return current()->find(info); }
+
+	const Type* find(const char* name) const { return current()->find(name); }
+
+	const Type* at(size_t index) const { return current()->at(index); }
+
+	const Type* find_key(unsigned key) const { return current()->find_key(key); }
+
+	size_t size() const { return current()->size(); }
+
+	/// Changes on every registration, so cached lookups know they are stale
+	unsigned generation() const {
+#ifdef S11N_CPP03
+		return generation_;
+#else
+		return generation_.load(std::memory_order_acquire);
+#endif
+	}
+
+protected:
+	const TypeSnapshot* current() const {
+#ifdef S11N_CPP03
+		return current_;
+#else
+		return current_.load(std::memory_order_acquire);
+#endif
+	}
+
+	/// Replaced snapshot is kept, so lookups running in it stay valid
+	void publish(TypeSnapshot* next) {
+		retired_.push_back(current());
+#ifdef S11N_CPP03
+		current_ = next;
+		++generation_;
+#else
+		current_.store(next, std::memory_order_release);
+		generation_.fetch_add(1, std::memory_order_release);
+#endif
+	}
+
+	void free_retired() {
+		for (size_t i = 0; i < retired_.size(); ++i)
+			delete retired_[i];
+		retired_.clear();
+	}
+
+	TypeRegistry(const TypeRegistry&);
+	TypeRegistry& operator = (const TypeRegistry&);
+
+#ifdef S11N_CPP03
+	const TypeSnapshot*               current_;
+	unsigned                          generation_;
+#else
+	std::atomic<const TypeSnapshot*>  current_;
+	std::atomic<unsigned>             generation_;
+	mutable std::mutex                mutex_;
+#endif
+	std::deque<Type>                  types_; /// Adding to end keeps addresses of types
+	std::vector<const TypeSnapshot*>  retired_;
+};
+
+/// Last type found at call site. Repeated pointers of the same type skip lookup at all
+struct TypeCache {
+	const std::type_info* info;
+	unsigned              key;  /// Key of last type found by key
+	const Type*           type;
+	unsigned              generation;
+
+	TypeCache() : info(S11N_NULLPTR), key(0), type(S11N_NULLPTR), generation(0) {}
 };
 
 /// Define used in serializer-specific storages
 #define S11N_TYPE_STORAGE\
 	public:\
-		typedef std::vector<Type> TypesT;\
-		static std::vector<Type>& t() {\
-			static std::vector<Type> types;\
+		typedef TypeRegistry TypesT;\
+		static TypeRegistry& t() {\
+			static TypeRegistry types;\
 			return types;\
 		}
 
@@ -167,38 +593,71 @@ class TypeStorageAccessor {
 public:
 	template <class T>
 	static bool is_registered(const std::string& alias) {
+		const TypeRegistry& types = Storage::t();
 		const TypeIndex type = typeid(T);
-		typename Storage::TypesT::const_iterator i = Storage::t().begin();
-		for (; i != Storage::t().end(); ++i) {
-			if (i->info == type || (i->alias == alias && !alias.empty()) || i->alias == type.name()) 
-				return true;
-		}
-		return false;
+		return types.find(type) != S11N_NULLPTR 
+			|| (!alias.empty() && types.find(alias.c_str()) != S11N_NULLPTR);
 	}
  	
+	/// Plant is deleted, if type or alias is registered already
 	template <class T>
 	static void register_type(BasePlant* ctor, const std::string& alias) {
-		S11N_ASSERT(!is_registered<T>(alias));
 		Type t(typeid(T));
 		t.ctor  = ctor;
 		t.alias = alias;
-		Storage::t().push_back(t); 
+		const bool added = Storage::t().add(t);
+		S11N_ASSERT(added && "Type or alias is registered already!");
+		if (!added)
+			delete ctor;
+	}
+
+	/// Type by registration number. Same order of registration gives the same numbers
+	static const Type* get(unsigned id) {
+		return id != 0? Storage::t().at(id - 1) : S11N_NULLPTR;
+	}
+
+	/// Type by key written to stream
+	static const Type* find_key(unsigned key) {
+		return Storage::t().find_key(key);
+	}
+
+	/// Lookup by key remembering last result in cache of call site. Cache must be thread local
+	static const Type* find_key(unsigned key, TypeCache& cache) {
+		const TypeRegistry& types = Storage::t();
+		const unsigned generation = types.generation();
+		if (cache.key != key || cache.generation != generation) {
+			cache.type       = types.find_key(key);
+			cache.key        = key;
+			cache.generation = generation;
+		}
+		return cache.type;
 	}
 
+	/// Type by name of type or alias
 	static const Type* find(const char* type) {
-		typename Storage::TypesT::const_iterator i = Storage::t().begin();
-		for (; i != Storage::t().end(); ++i) {
-			if (std::strcmp(i->info.name(), type) == 0) 
-				return &*i;
+		return Storage::t().find(type);
+	}
+
+	static const Type* find(const std::type_info& info) {
+		return Storage::t().find(TypeIndex(info));
+	}
+
+	/// Lookup remembering last result in cache of call site. Cache must be thread local
+	static const Type* find(const std::type_info& info, TypeCache& cache) {
+		const TypeRegistry& types = Storage::t();
+		const unsigned generation = types.generation();
+		if (cache.info != &info || cache.generation != generation) {
+			cache.type       = types.find(TypeIndex(info));
+			cache.info       = &info;
+			cache.generation = generation;
 		}
-		return S11N_NULLPTR;
+		return cache.type;
 	}
 
 	static void clean() {
-		typename Storage::TypesT::const_iterator i = Storage::t().begin();
-		for (; i != Storage::t().end(); ++i) {
-			delete i->ctor;
-		}
+		std::vector<const Type*> types = Storage::t().types();
+		for (size_t i = 0; i < types.size(); ++i)
+			delete types[i]->ctor;
 		Storage::t().clear();
 	}
 };
@@ -334,6 +793,21 @@ public:
 	}
 };
 
+/// Specialize template or use S11N_UNSHARED for types, which objects are never pointed twice.
+/// Pointers to them are written and read without references tables
+template <class T>
+class Unshared {
+public:
+	static const bool value = false;
+};
+
+#define S11N_UNSHARED(Type)\
+	template <>\
+	class Unshared<Type> {\
+	public:\
+		static const bool value = true;\
+	};
+
 class Constructor {
 public:
 	Constructor() {}
@@ -407,6 +881,14 @@ public:
 		access_impl_ref(name, get, set, node_.essence());
 	}
 
+#ifndef S11N_CPP03
+	/// Access member with const&-getter and rvalue-setter, so read value is moved to object
+	template <class T>
+	void access(const char* name, const T& (Object::* get)() const, void (Object::* set)(T&&))	{
+		access_impl_move(name, get, set, node_.essence());
+	}
+#endif
+
 	/// Optional member with not-const getter
 	template <class T>
 	void optional(const char* name, const T& def, T (Object::* get)(), void (Object::* set)(T)) {
@@ -419,6 +901,19 @@ public:
 		optional_impl(name, def, get, set, node_.essence());
 	}
 
+#ifndef S11N_CPP03
+	/// Optional member with const&-getter and rvalue-setter
+	template <class T>
+	void optional(const char* name, const T& def, const T& (Object::* get)() const, void (Object::* set)(T&&)) {
+		optional_impl_move(name, def, get, set, node_.essence());
+	}
+
+	/// Optional member for small std::string magic with rvalue-setter
+	void optional(const char* name, const char* def, const std::string& (Object::* get)() const, void (Object::* set)(std::string&&)) {
+		optional(name, std::string(def), get, set);
+	}
+#endif
+
 	/// Optional member for small std::string magic
 	void optional(const char* name, const char* def, const std::string& (Object::* get)() const, void (Object::* set)(const std::string&)) {
 		optional(name, std::string(def), get, set);
@@ -431,7 +926,7 @@ protected:
 	void access_impl(const char* name, T (Object::* get)(), void (Object::* set)(T), InputEssence&) {
 		T val;
 		node_.named(val, name);
-		(obj_->*set)(val);
+		(obj_->*set)(S11N_MOVE(val));
 	}
 
 	template <class T>
@@ -448,7 +943,7 @@ protected:
 	void access_impl(const char* name, T (Object::* get)() const, void (Object::* set)(T), InputEssence&) {
 		T val;
 		node_.named(val, name);
-		(obj_->*set)(val);
+		(obj_->*set)(S11N_MOVE(val));
 	}
 
 	template <class T>
@@ -468,30 +963,53 @@ protected:
 	void access_impl_ref(const char* name, const T& (Object::* get)() const, void (Object::* set)(const T&), InputEssence&)	{
 		T val;
 		node_.named(val, name);
-		(obj_->*set)(val);
+		(obj_->*set)(S11N_MOVE(val));
 	}
 
 	template <class T>
 	void access_impl_ref(const char* name, const T& (Object::* get)() const, void (Object::* set)(const T&), OutputEssence&) {
-		T val = (obj_->*get)();
-		node_.named(val, name);
+		node_.named(const_cast<T&>((obj_->*get)()), name);
 	}
 
 	template <class T>
 	void access_impl_ref(const char*, const T& (Object::*)() const, void (Object::*)(const T&), ConstructEssence&) {}
 
+#ifndef S11N_CPP03
+	// With rvalue setter and const& getter
+	template <class T>
+	void access_impl_move(const char* name, const T& (Object::*)() const, void (Object::* set)(T&&), InputEssence&)	{
+		T val;
+		node_.named(val, name);
+		(obj_->*set)(std::move(val));
+	}
+
+	template <class T>
+	void access_impl_move(const char* name, const T& (Object::* get)() const, void (Object::*)(T&&), OutputEssence&) {
+		node_.named(const_cast<T&>((obj_->*get)()), name);
+	}
+
+	template <class T>
+	void access_impl_move(const char*, const T& (Object::*)() const, void (Object::*)(T&&), ConstructEssence&) {}
+#endif
+
 	// Templated getter, setter
 	template <class T, class Getter, class Setter>
 	void access_free_impl(const char* name, Getter get, Setter set, InputEssence&) {
 		T val;
 		node_.named(val, name);
-		(obj_->*set)(val);
+		(obj_->*set)(S11N_MOVE(val));
 	}
 
 	template <class T, class Getter, class Setter>
 	void access_free_impl(const char* name, Getter get, Setter set, OutputEssence&) {
+#ifdef S11N_CPP03
 		T val = (obj_->*get)();
 		node_.named(val, name);
+#else
+		// Getters returning references aren't copied
+		auto&& val = (obj_->*get)();
+		node_.named(const_cast<T&>(static_cast<const T&>(val)), name);
+#endif
 	}
 
 	template <class T, class Getter, class Setter>
@@ -502,7 +1020,7 @@ protected:
 	void optional_impl(const char* name, const T& def, T (Object::*)(), void (Object::* set)(T), InputEssence&)	{
 		T val;
 		node_.optional(val, name, def);
-		(obj_->*set)(val);
+		(obj_->*set)(S11N_MOVE(val));
 	}
 
 	template <class T>
@@ -513,7 +1031,7 @@ protected:
 
 	template <class T>
 	void optional_impl(const char* name, const T& def, T (Object::*)(), void (Object::* set)(T), ConstructEssence&) {
-		obj_->set(def);
+		(obj_->*set)(def);
 	}
 
 	// Const getter
@@ -521,20 +1039,39 @@ protected:
 	void optional_impl(const char* name, const T& def, const T& (Object::* )() const, void (Object::* set)(const T&), InputEssence&) {
 		T val;
 		node_.optional(val, name, def);
-		(obj_->*set)(val);
+		(obj_->*set)(S11N_MOVE(val));
 	}
 
 	template <class T>
 	void optional_impl(const char* name, const T& def, const T& (Object::* get)() const, void (Object::*)(const T&), OutputEssence&) {
-		T val = (obj_->*get)();
-		node_.optional(val, name, def);
+		node_.optional(const_cast<T&>((obj_->*get)()), name, def);
 	}
 
 	template <class T>
 	void optional_impl(const char* name, const T& def, const T& (Object::*)() const, void (Object::* set)(const T&), ConstructEssence&)	{
-		obj_->set(def);
+		(obj_->*set)(def);
 	}
 
+#ifndef S11N_CPP03
+	// Rvalue setter
+	template <class T>
+	void optional_impl_move(const char* name, const T& def, const T& (Object::*)() const, void (Object::* set)(T&&), InputEssence&) {
+		T val;
+		node_.optional(val, name, def);
+		(obj_->*set)(std::move(val));
+	}
+
+	template <class T>
+	void optional_impl_move(const char* name, const T& def, const T& (Object::* get)() const, void (Object::*)(T&&), OutputEssence&) {
+		node_.optional(const_cast<T&>((obj_->*get)()), name, def);
+	}
+
+	template <class T>
+	void optional_impl_move(const char*, const T& def, const T& (Object::*)() const, void (Object::* set)(T&&), ConstructEssence&) {
+		(obj_->*set)(T(def));
+	}
+#endif
+
 protected:
 	Object* obj_;
 	Node&   node_;
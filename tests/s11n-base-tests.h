@@ -4,6 +4,8 @@
 #include <bike/s11n.h>
 #include <bike/s11n-xml.h>
 #include <bike/s11n-xml-stl.h>
+#include <bike/s11n-binary.h>
+#include <bike/s11n-sbinary-stl.h>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <fstream>
@@ -12,7 +14,7 @@
 
 using namespace bike;
 
-typedef testing::Types<XmlSerializer> TestSerializers;
+typedef testing::Types<XmlSerializer, BinarySerializer> TestSerializers;
 
 template <class Serializer>
 class TemplateTest : public testing::Test {
@@ -24,7 +26,7 @@ public:
 TYPED_TEST_CASE_P(TemplateTest);
 
 TYPED_TEST_P(TemplateTest, Multiply0) {
-	std::ofstream fout("test.txt");
+	std::ofstream fout("test.txt", std::ios::binary);
 	Output out(fout);
 
 	std::string aw = "One object", ar;
@@ -35,7 +37,7 @@ TYPED_TEST_P(TemplateTest, Multiply0) {
 
 	fout.close();
 
-	std::ifstream fin("test.txt");
+	std::ifstream fin("test.txt", std::ios::binary);
 	Input in(fin);
 
 	in >> ar >> br;
@@ -71,7 +73,7 @@ struct X2 {
 };
 
 TYPED_TEST_P(TemplateTest, Version0) {
-	std::ofstream fout("test.txt");
+	std::ofstream fout("test.txt", std::ios::binary);
 	Output out(fout);
 
 	X1 w1(5);
@@ -82,7 +84,7 @@ TYPED_TEST_P(TemplateTest, Version0) {
 
 	fout.close();
 
-	std::ifstream fin("test.txt");
+	std::ifstream fin("test.txt", std::ios::binary);
 	Input in(fin);
 
 	in >> r2 >> r22;
@@ -93,10 +95,52 @@ TYPED_TEST_P(TemplateTest, Version0) {
 	ASSERT_EQ(w2.y, r22.y);
 }
 
+struct Message {
+	ProtocolVersion protocol;
+	int             x, y;
+
+	Message(unsigned protocol = 2) : protocol(protocol), x(0), y(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		protocol.setup(node);
+		node & x;
+		if (protocol.version() > 1)
+			node & y;
+	}
+};
+
+TYPED_TEST_P(TemplateTest, ProtocolVersion) {
+	std::ofstream fout("test.txt", std::ios::binary);
+	Output out(fout);
+
+	Message w(2), w1(1);
+	w.x = 3, w.y = 4;
+	w1.x = 5, w1.y = 6;
+	// Versions differ between objects of one type
+	out << w << w1 << w;
+	fout.close();
+
+	std::ifstream fin("test.txt", std::ios::binary);
+	Input in(fin);
+
+	Message r(2), r1(2), r2(2);
+	in >> r >> r1 >> r2;
+	ASSERT_EQ(2u, r.protocol.version());
+	ASSERT_EQ(3, r.x);
+	ASSERT_EQ(4, r.y);
+	ASSERT_EQ(1u, r1.protocol.version());
+	ASSERT_EQ(5, r1.x);
+	ASSERT_EQ(0, r1.y);
+	ASSERT_EQ(2u, r2.protocol.version());
+	ASSERT_EQ(4, r2.y);
+}
+
 REGISTER_TYPED_TEST_CASE_P(
 	TemplateTest, 
 	Multiply0,
-	Version0
+	Version0,
+	ProtocolVersion
 );
 
 INSTANTIATE_TYPED_TEST_CASE_P(TTest, TemplateTest, TestSerializers);
@@ -143,13 +187,13 @@ public:
 	}
 
 #define WRITE(Write)\
-		std::ofstream fout("test.txt");\
+		std::ofstream fout("test.txt", std::ios::binary);\
 		Output out(fout);\
 		out << (Write);\
 		fout.close();\
 
 #define READ(Read)\
-		std::ifstream fin("test.txt");\
+		std::ifstream fin("test.txt", std::ios::binary);\
 		Input in(fin);\
 		in >> (Read);\
 
@@ -313,6 +357,51 @@ TYPED_TEST_P(BaseTest, SmartPointers) {
 	test_deref_impl(alex, read3);
 }
 
+struct SharedPair {
+	std::vector<std::shared_ptr<Human> > items;
+
+	template <class Node>
+	void ser(Node& node) {
+		node & items;
+	}
+};
+
+TYPED_TEST_P(BaseTest, SharedOwnership) {
+	SharedPair write, read;
+	std::shared_ptr<Human> human(new Human("Shared Human"));
+	write.items.push_back(human);
+	write.items.push_back(human);
+	io_impl(write, read);
+
+	ASSERT_EQ(2u, read.items.size());
+	ASSERT_EQ("Shared Human", read.items[0]->name());
+	ASSERT_EQ(read.items[0].get(), read.items[1].get());
+	ASSERT_EQ(2, read.items[0].use_count());
+}
+
+struct SelfLink {
+	int       value;
+	SelfLink* self;
+
+	SelfLink(int value = 0) : value(value), self(S11N_NULLPTR) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node & value & self;
+	}
+};
+
+TYPED_TEST_P(BaseTest, Cycles) {
+	SelfLink* write = new SelfLink(7), *read = S11N_NULLPTR;
+	write->self = write;
+	io_ptr_impl(const_cast<const SelfLink*&>(write), read);
+
+	ASSERT_TRUE(read != S11N_NULLPTR);
+	ASSERT_EQ(7, read->value);
+	ASSERT_EQ(read, read->self);
+	delete write, delete read;
+}
+
 TYPED_TEST_P(BaseTest, SequenceContainers) {
 	std::vector<int> empty_vec;
 	test_val(empty_vec);
@@ -327,6 +416,10 @@ TYPED_TEST_P(BaseTest, SequenceContainers) {
 	std::list<int> list;
 	list.push_back(4), list.push_back(5), list.push_back(6);
 	test_val(list);
+
+	std::vector<bool> bits;
+	bits.push_back(true), bits.push_back(false), bits.push_back(true);
+	test_val(bits);
 }
 
 TYPED_TEST_P(BaseTest, Inheritance) {
@@ -355,6 +448,7 @@ void serialize(IntegerHolder& integer, Node& node) {
 }
 
 S11N_XML_OUT(IntegerHolder, serialize);
+S11N_BINARY_OUT(IntegerHolder, serialize);
 
 TYPED_TEST_P(BaseTest, OutOfClass) {
 	IntegerHolder integer, read;
@@ -421,6 +515,68 @@ TYPED_TEST_P(BaseTest, Optional) {
 	test_val(conf);
 }
 
+struct TreeNode {
+	int                       value;
+	std::unique_ptr<TreeNode> left;
+	std::unique_ptr<TreeNode> right;
+
+	TreeNode(int value = 0) : value(value) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node & value & left & right;
+	}
+};
+
+S11N_UNSHARED(TreeNode);
+
+TYPED_TEST_P(BaseTest, Unshared) {
+	TreeNode root(1), read;
+	root.left.reset(new TreeNode(2));
+	root.right.reset(new TreeNode(3));
+	root.right->left.reset(new TreeNode(4));
+	io_impl(root, read);
+
+	ASSERT_EQ(1, read.value);
+	ASSERT_EQ(2, read.left->value);
+	ASSERT_EQ(3, read.right->value);
+	ASSERT_EQ(4, read.right->left->value);
+	ASSERT_TRUE(read.left->left.get() == S11N_NULLPTR);
+}
+
+TYPED_TEST_P(BaseTest, Sessions) {
+	Human* common = new Human("Common"), *first = new Human("First"), *second = new Human("Second");
+	{
+		std::ofstream fout("test.txt", std::ios::binary);
+		typename TestFixture::Output out(fout);
+		out.refs()->pin(common);
+		out << common << first;
+		out.end_session();
+		out << common << second;
+	}
+
+	Human* common_read = S11N_NULLPTR, *first_read = S11N_NULLPTR;
+	Human* common_read2 = S11N_NULLPTR, *second_read = S11N_NULLPTR;
+	{
+		std::ifstream fin("test.txt", std::ios::binary);
+		typename TestFixture::Input in(fin);
+		in >> common_read >> first_read;
+		in >> common_read2 >> second_read;
+		// Only pinned object is kept
+		ASSERT_EQ((void*) common_read, in.refs()->get(1));
+		ASSERT_EQ((void*) second_read, in.refs()->get(2));
+		ASSERT_TRUE(in.refs()->get(3) == S11N_NULLPTR);
+	}
+
+	ASSERT_EQ(common_read, common_read2);
+	ASSERT_EQ("Common", common_read->name());
+	ASSERT_EQ("First",  first_read->name());
+	ASSERT_EQ("Second", second_read->name());
+
+	delete common, delete first, delete second;
+	delete common_read, delete first_read, delete second_read;
+}
+
 REGISTER_TYPED_TEST_CASE_P(
 	BaseTest, 
 	Base, 
@@ -429,11 +585,15 @@ REGISTER_TYPED_TEST_CASE_P(
 	Classes, 
 	Pointers, 
 	SmartPointers,
+	SharedOwnership,
+	Cycles,
 	SequenceContainers,
 	Inheritance,
 	OutOfClass,
 	Benchmark,
-	Optional
+	Optional,
+	Unshared,
+	Sessions
 );
 
 INSTANTIATE_TYPED_TEST_CASE_P(Test, BaseTest, TestSerializers);
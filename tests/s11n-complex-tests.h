@@ -2,8 +2,16 @@
 #include "s11n-tests.h"
 #include <bike/s11n.h>
 #include <bike/s11n-xml.h>
+#include <bike/s11n-sbinary.h>
+#include <bike/s11n-sbinary-stl.h>
+#include <bike/s11n-binary.h>
+#include <bike/s11n-schema.h>
 #include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
 #include <memory>
+#include <sstream>
+#include <thread>
 
 using namespace bike;
 
@@ -49,6 +57,7 @@ void serialize_widget(Widget& widget, Node& node) {
 }
 
 S11N_XML_OUT(Widget, serialize_widget);
+S11N_BINARY_OUT(Widget, serialize_widget);
 
 bool operator == (const Widget& a, const Widget& b) {
 	return a.name() == b.name();// FIXME: add child widgets comparison
@@ -78,3 +87,428 @@ TEST(Complex, 0) {
 
 	ASSERT_EQ(*root, *root_read);
 }
+
+TEST(Complex, Binary) {
+	WidgetUPtr root, root_read;
+	root.reset(new Widget(S11N_NULLPTR));
+	root->set_name("Root");
+
+	WidgetUPtr child, child_read;
+	child.reset(new Widget(root.get()));
+	child->set_name("Child");
+
+	std::stringstream stream;
+	OstreamWriter writer(stream);
+	OutputBinaryStreaming out(&writer);
+	out << root << child;
+
+	IstreamReader reader(stream);
+	InputBinaryStreaming in(&reader);
+	in >> root_read >> child_read;
+
+	ASSERT_EQ(*root, *root_read);
+	ASSERT_EQ(*child, *child_read);
+	ASSERT_EQ(root_read.get(), child_read->parent());
+}
+
+TEST(Complex, BinaryCorruptedSize) {
+	std::stringstream stream;
+	OstreamWriter writer(stream);
+	EncoderImpl<UnsignedNumber>::encode(&writer, UnsignedNumber(uint64_t(1) << 40));
+	int32_t one = 1;
+	writer.write(&one, sizeof(one));
+
+	IstreamReader source(stream);
+	MemoryReader reader;
+	reader.load(&source, 64);
+	InputBinaryStreaming in(&reader);
+	// Size of vector is larger than data left, so nothing is allocated
+	std::vector<int32_t> read(2, 7);
+	in >> read;
+	ASSERT_TRUE(read.empty());
+	ASSERT_EQ(sizeof(one), reader.left());
+}
+
+TEST(Complex, BinaryCutRecord) {
+	MemoryReader empty;
+	UnsignedNumber number = 5;
+	DecoderImpl<UnsignedNumber>::decode(&empty, number);
+	ASSERT_EQ(0u, uint64_t(number));
+	ASSERT_TRUE(empty.failed());
+
+	Record<1> record, read;
+	record.id   = 5;
+	record.text = "Cut";
+	std::stringstream stream;
+	{
+		OutputBinarySerializer out(stream);
+		out << record;
+	}
+	std::string data = stream.str();
+	std::stringstream cut(data.substr(0, data.size() - 2));
+
+	// Record is shorter than its size, so it is rejected
+	InputBinarySerializer in(cut);
+	read.id = 7;
+	in >> read;
+	ASSERT_TRUE(in.failed());
+	ASSERT_EQ(7, read.id);
+	ASSERT_EQ("", read.text);
+
+	// Reading after end of stream fails too
+	std::stringstream whole(data);
+	InputBinarySerializer in_whole(whole);
+	in_whole >> read;
+	ASSERT_FALSE(in_whole.failed());
+	ASSERT_EQ(5, read.id);
+	in_whole >> read;
+	ASSERT_TRUE(in_whole.failed());
+}
+
+/// Names of fields are built in the same buffer
+struct BufferNames {
+	int first, second;
+
+	BufferNames() : first(0), second(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		char name[8];
+		std::strcpy(name, "first");
+		node.named(first, name);
+		std::strcpy(name, "second");
+		node.named(second, name);
+	}
+};
+
+TEST(Complex, BinaryNamesByContent) {
+	BufferNames w, r;
+	w.first  = 1;
+	w.second = 2;
+	std::stringstream stream;
+	OutputBinarySerializer out(stream);
+	out << w;
+	ASSERT_NE(std::string::npos, stream.str().find("first"));
+	ASSERT_NE(std::string::npos, stream.str().find("second"));
+
+	InputBinarySerializer in(stream);
+	in >> r;
+	ASSERT_EQ(1, r.first);
+	ASSERT_EQ(2, r.second);
+}
+
+struct PointFields {
+	int x, y;
+
+	PointFields() : x(0), y(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(x, "x");
+		node.named(y, "y");
+	}
+};
+
+struct SegmentWriter {
+	int         id;
+	PointFields from, to;
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(id, "id");
+		node.named(from, "from");
+		node.named(to, "to");
+	}
+};
+
+/// Reads fields of SegmentWriter in other order and has field unknown to writer
+struct SegmentReader {
+	int         id, color;
+	PointFields from, to;
+
+	SegmentReader() : id(0), color(7) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(to, "to");
+		node.named(color, "color");
+		node.named(from, "from");
+		node.named(id, "id");
+	}
+};
+
+TEST(Complex, BinaryReorderedFields) {
+	SegmentWriter w;
+	w.id = 5;
+	w.from.x = 1, w.from.y = 2;
+	w.to.x   = 3, w.to.y   = 4;
+	SegmentReader r;
+	std::stringstream stream;
+	OutputBinarySerializer out(stream);
+	out << w << w;
+
+	InputBinarySerializer in(stream);
+	for (int i = 0; i < 2; ++i) {
+		in >> r;
+		ASSERT_EQ(5, r.id);
+		ASSERT_EQ(7, r.color);
+		ASSERT_EQ(1, r.from.x);
+		ASSERT_EQ(2, r.from.y);
+		ASSERT_EQ(3, r.to.x);
+		ASSERT_EQ(4, r.to.y);
+	}
+}
+
+TEST(Complex, ConstructOutOfClass) {
+	Widget widget;
+	widget.set_name("Not default");
+
+	Constructor con;
+	serialize_widget(widget, con);
+	ASSERT_EQ("", widget.name());
+}
+
+TEST(Complex, TypeRegistry) {
+	TypeRegistry types;
+	Type widget(typeid(Widget));
+	widget.alias = "widget";
+	types.add(widget);
+	types.add(Type(typeid(int)));
+
+	ASSERT_EQ(TypeIndex(typeid(Widget)), types.find(TypeIndex(typeid(Widget)))->info);
+	ASSERT_EQ(TypeIndex(typeid(int)),    types.find(typeid(int).name())->info);
+	ASSERT_EQ(TypeIndex(typeid(Widget)), types.find("widget")->info);
+	ASSERT_TRUE(types.find(TypeIndex(typeid(double))) == S11N_NULLPTR);
+	ASSERT_TRUE(types.find("unknown") == S11N_NULLPTR);
+
+	// Aliases give stable keys, other types are keyed by number of registration
+	ASSERT_EQ(Type::alias_key("widget"), types.find("widget")->key);
+	ASSERT_EQ(2u, types.find(typeid(int).name())->key);
+	ASSERT_EQ(types.find("widget"), types.find_key(Type::alias_key("widget")));
+	ASSERT_EQ(types.find(typeid(int).name()), types.find_key(2));
+	ASSERT_TRUE(types.find_key(3) == S11N_NULLPTR);
+
+	TypeCache cache;
+	const Type* found = TypeStorageAccessor<BinarySerializerStorage>::find(typeid(Circle), cache);
+	ASSERT_TRUE(found != S11N_NULLPTR);
+	ASSERT_EQ(found, TypeStorageAccessor<BinarySerializerStorage>::find(typeid(Circle), cache));
+	ASSERT_EQ(found, TypeStorageAccessor<BinarySerializerStorage>::find(typeid(Circle).name()));
+
+	TypeCache key_cache;
+	ASSERT_EQ(found, TypeStorageAccessor<BinarySerializerStorage>::find_key(found->key, key_cache));
+	ASSERT_EQ(found->key, key_cache.key);
+	ASSERT_EQ(found, TypeStorageAccessor<BinarySerializerStorage>::find_key(found->key, key_cache));
+}
+
+TEST(Complex, References) {
+	std::vector<int> objects(1000);
+	ReferencesPtr ptrs(objects.size());
+	ReferencesId  ids;
+	for (size_t i = 0; i < objects.size(); ++i) {
+		std::pair<bool, unsigned> set_result = ptrs.set(&objects[i]);
+		ASSERT_TRUE(set_result.first);
+		ASSERT_EQ(unsigned(i + 1), set_result.second);
+		ids.set(set_result.second, &objects[i]);
+	}
+
+	for (size_t i = 0; i < objects.size(); ++i) {
+		std::pair<bool, unsigned> set_result = ptrs.set(&objects[i]);
+		ASSERT_FALSE(set_result.first);
+		ASSERT_EQ(&objects[i], ids.get(set_result.second));
+	}
+	ASSERT_EQ(0u, ptrs.get(&ptrs));
+	ASSERT_TRUE(ids.get(5000) == S11N_NULLPTR);
+}
+
+TEST(Complex, ReferencesCorrupted) {
+	ReferencesId ids;
+	ASSERT_TRUE(ids.accept(1));
+	ASSERT_TRUE(ids.accept(ReferencesId::MAX_GAP));
+	ASSERT_FALSE(ids.accept(3 * ReferencesId::MAX_GAP));
+	ASSERT_FALSE(ids.accept(uint64_t(1) << 40));
+
+	// Ids are counted from kept ones in new session
+	std::vector<unsigned> kept(1, 1);
+	ids.reset(kept);
+	ASSERT_FALSE(ids.accept(ReferencesId::MAX_GAP + 2));
+	ASSERT_TRUE(ids.accept(ReferencesId::MAX_GAP + 1));
+}
+
+template <int N>
+struct Numbered {};
+
+TEST(Complex, TypeRegistryThreads) {
+	TypeRegistry types;
+	types.add(Type(typeid(Widget)));
+
+	bool found_always = true;
+	std::thread reader([&types, &found_always]() {
+		for (int i = 0; i < 10000; ++i)
+			found_always = found_always && types.find(TypeIndex(typeid(Widget))) != S11N_NULLPTR;
+	});
+	types.add(Type(typeid(Numbered<0>)));
+	types.add(Type(typeid(Numbered<1>)));
+	types.add(Type(typeid(Numbered<2>)));
+	reader.join();
+
+	ASSERT_TRUE(found_always);
+	ASSERT_EQ(4u, types.size());
+	ASSERT_EQ(4u, types.find(TypeIndex(typeid(Numbered<2>)))->id);
+}
+
+TEST(Complex, TypeRegistryOnce) {
+	TypeRegistry types;
+	Type widget(typeid(Widget));
+	widget.alias = "widget";
+	ASSERT_TRUE(types.add(widget));
+	ASSERT_FALSE(types.add(Type(typeid(Widget))));
+	Type other(typeid(int));
+	other.alias = "widget";
+	ASSERT_FALSE(types.add(other));
+	ASSERT_EQ(1u, types.size());
+
+	// Aliases with the same hash would be the same key in stream
+	Type costarring(typeid(Numbered<2>)), liquid(typeid(Numbered<3>));
+	costarring.alias = "costarring";
+	liquid.alias     = "liquid";
+	ASSERT_EQ(Type::alias_key(costarring.alias), Type::alias_key(liquid.alias));
+	ASSERT_TRUE(types.add(costarring));
+	ASSERT_FALSE(types.add(liquid));
+	ASSERT_EQ(2u, types.size());
+
+	// Threads registering the same types add every type once
+	std::vector<std::thread> threads;
+	std::atomic<int> added(0);
+	for (int i = 0; i < 4; ++i) {
+		threads.push_back(std::thread([&types, &added]() {
+			added += types.add(Type(typeid(Numbered<0>)));
+			added += types.add(Type(typeid(Numbered<1>)));
+		}));
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+	ASSERT_EQ(2, added.load());
+	ASSERT_EQ(4u, types.size());
+	ASSERT_EQ(4u, types.types().size());
+}
+
+struct Payload {
+	static int copies;
+
+	std::vector<int> data;
+
+	Payload() {}
+
+	Payload(const Payload& p) : data(p.data) { ++copies; }
+
+	Payload(Payload&& p) : data(std::move(p.data)) {}
+
+	Payload& operator = (const Payload& p) { data = p.data; ++copies; return *this; }
+
+	Payload& operator = (Payload&& p) { data = std::move(p.data); return *this; }
+
+	template <class Node>
+	void ser(Node& node) {
+		node & data;
+	}
+};
+
+int Payload::copies = 0;
+
+class Document {
+public:
+	const Payload& payload() const { return payload_; }
+
+	void set_payload(Payload&& payload) { payload_ = std::move(payload); }
+
+protected:
+	Payload payload_;
+};
+
+template <class Node>
+void serialize_document(Document& doc, Node& node) {
+	Accessor<Document, Node> acc(&doc, node);
+	acc.access("payload", &Document::payload, &Document::set_payload);
+}
+
+S11N_BINARY_OUT(Document, serialize_document);
+S11N_SCHEMA_OUT(Document, serialize_document);
+
+TEST(Complex, AccessorWithoutCopies) {
+	Payload payload;
+	payload.data.assign(1000, 7);
+	Document doc, read;
+	doc.set_payload(std::move(payload));
+
+	std::stringstream stream;
+	OstreamWriter writer(stream);
+	OutputBinaryStreaming out(&writer);
+	out << doc;
+
+	IstreamReader reader(stream);
+	InputBinaryStreaming in(&reader);
+	in >> read;
+
+	ASSERT_EQ(doc.payload().data, read.payload().data);
+	ASSERT_EQ(0, Payload::copies);
+}
+
+TEST(Complex, SchemaOutOfClass) {
+	Schema schema = describe<Document>();
+	ASSERT_EQ(1u, schema.fields.size());
+	ASSERT_EQ("payload", schema.fields[0].name);
+	ASSERT_EQ(Schema::SEQUENCE, schema.fields[0].fields[0].kind);
+}
+
+struct MixedOptional {
+	int a, b, c, d;
+
+	MixedOptional() : a(0), b(0), c(0), d(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(a, "a");
+		node.optional(b, "b", 0);
+		node.named(c, "c");
+		node.optional(d, "d", 0);
+	}
+};
+
+/// Optional fields around object with own optional fields
+struct NestedOptional {
+	int           x, y;
+	MixedOptional inner;
+
+	NestedOptional() : x(0), y(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.optional(x, "x", 0);
+		node.named(inner, "inner");
+		node.optional(y, "y", 0);
+	}
+};
+
+TEST(Complex, BinaryOptionalInPlace) {
+	NestedOptional w, r;
+	w.x = 1, w.y = 0, w.inner.b = 2, w.inner.c = 3, w.inner.d = 4;
+
+	// Bitmaps are inserted in memory writer and written before delayed fields to stream
+	MemoryWriter memory;
+	OutputBinaryStreaming memory_out(&memory);
+	memory_out << w;
+	std::stringstream stream;
+	OstreamWriter writer(stream);
+	OutputBinaryStreaming stream_out(&writer);
+	stream_out << w;
+	ASSERT_EQ(stream.str(), std::string(memory.data(), memory.size()));
+
+	IstreamReader reader(stream);
+	InputBinaryStreaming in(&reader);
+	in >> r;
+	ASSERT_EQ(1, r.x);
+	ASSERT_EQ(0, r.y);
+	ASSERT_EQ(2, r.inner.b);
+	ASSERT_EQ(3, r.inner.c);
+	ASSERT_EQ(4, r.inner.d);
+}
@@ -0,0 +1,257 @@
+// s11n
+//
+#include "s11n-tests.h"
+#include <bike/s11n.h>
+#include <bike/s11n-schema.h>
+#include <bike/s11n-binary.h>
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace bike;
+
+struct VersionedSample {
+	int                    id;
+	std::vector<Superman>  heroes;
+	Superman*              leader;
+
+	VersionedSample() : id(0), leader(S11N_NULLPTR) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.decl_version(3);
+		node.named(id, "id");
+		node.named(heroes, "heroes");
+		node.named(leader, "leader");
+	}
+};
+
+TEST(Schema, Fields) {
+	Schema schema = describe<VersionedSample>();
+	ASSERT_EQ(Schema::OBJECT, schema.kind);
+	ASSERT_EQ(3u, schema.version);
+	ASSERT_EQ(3u, schema.fields.size());
+
+	const Schema& id = schema.fields[0];
+	ASSERT_EQ("id", id.name);
+	ASSERT_EQ(Schema::VALUE, id.kind);
+	ASSERT_EQ(TypeIndex(typeid(int)), id.info);
+
+	const Schema& heroes = schema.fields[1];
+	ASSERT_EQ(Schema::SEQUENCE, heroes.kind);
+	ASSERT_EQ(1u, heroes.fields.size());
+
+	const Schema& hero = heroes.fields[0];
+	ASSERT_EQ(TypeIndex(typeid(Superman)), hero.info);
+	ASSERT_EQ(2u, hero.fields.size());
+	ASSERT_TRUE(hero.fields[0].base);
+	ASSERT_EQ("name", hero.fields[0].fields[0].name);
+	ASSERT_EQ("power", hero.fields[1].name);
+
+	const Schema& leader = schema.fields[2];
+	ASSERT_EQ(Schema::POINTER, leader.kind);
+	ASSERT_EQ(TypeIndex(typeid(Superman)), leader.info);
+	ASSERT_EQ(1u, leader.fields.size());
+	ASSERT_EQ(2u, leader.fields[0].fields.size());
+}
+
+TEST(Schema, Optional) {
+	Schema schema = describe<ConfigSample>();
+	ASSERT_EQ(3u, schema.fields.size());
+	ASSERT_EQ("start_url", schema.fields[1].name);
+	ASSERT_TRUE(schema.fields[1].optional);
+}
+
+struct Folder {
+	std::string         name;
+	std::vector<Folder> folders;
+
+	template <class Node>
+	void ser(Node& node) {
+		node & name & folders;
+	}
+};
+
+TEST(Schema, Recursive) {
+	Schema schema = describe<Folder>();
+	ASSERT_EQ(Schema::SEQUENCE, schema.fields[1].kind);
+	ASSERT_EQ(Schema::RECURSIVE, schema.fields[1].fields[0].kind);
+}
+
+template <unsigned Version>
+struct Record {
+	int         id;
+	std::string text;
+
+	Record() : id(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.decl_version(Version);
+		node.named(id, "id");
+		node.named(text, "text");
+	}
+};
+
+TEST(Schema, Fingerprint) {
+	ASSERT_EQ(fingerprint<Record<1> >(), fingerprint<Record<1> >());
+	ASSERT_NE(fingerprint<Record<1> >(), fingerprint<Record<2> >());
+	ASSERT_NE(fingerprint<Record<1> >(), fingerprint<Record<3> >());
+}
+
+template <class T>
+struct Holder {
+	T value;
+
+	Holder() : value() {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(value, "value");
+	}
+};
+
+template <class T, int Size>
+struct ArrayHolder {
+	T values[Size];
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(values, "values");
+	}
+};
+
+TEST(Schema, FingerprintOfPointeeAndSize) {
+	ASSERT_NE(fingerprint<Holder<Record<1>*> >(), fingerprint<Holder<Record<2>*> >());
+	ASSERT_NE((fingerprint<ArrayHolder<int, 2> >()), (fingerprint<ArrayHolder<int, 3> >()));
+	ASSERT_NE((fingerprint<Holder<std::array<int, 2> > >()), (fingerprint<Holder<std::array<int, 3> > >()));
+
+	Schema holder = describe<Holder<Holder<int>*> >();
+	ASSERT_EQ(Schema::POINTER, holder.fields[0].kind);
+	ASSERT_EQ(Schema::OBJECT, holder.fields[0].fields[0].kind);
+	ASSERT_STREQ("int", holder.fields[0].fields[0].fields[0].raw);
+}
+
+struct LinkedSample {
+	LinkedSample* next;
+
+	LinkedSample() : next(S11N_NULLPTR) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(next, "next");
+	}
+};
+
+TEST(Schema, RecursivePointer) {
+	Schema schema = describe<LinkedSample>();
+	ASSERT_EQ(Schema::POINTER, schema.fields[0].kind);
+	ASSERT_EQ(Schema::RECURSIVE, schema.fields[0].fields[0].kind);
+}
+
+struct AbstractSample {
+	virtual ~AbstractSample() {}
+	virtual int id() const = 0;
+
+	template <class Node>
+	void ser(Node&) {}
+};
+
+TEST(Schema, AbstractPointee) {
+	Schema schema = describe<Holder<AbstractSample*> >();
+	ASSERT_EQ(Schema::POINTER, schema.fields[0].kind);
+	ASSERT_EQ(TypeIndex(typeid(AbstractSample)), schema.fields[0].fields[0].info);
+	ASSERT_TRUE(schema.fields[0].fields[0].fields.empty());
+}
+
+TEST(Schema, Containers) {
+	Schema map = describe<Holder<std::map<std::string, int> > >().fields[0];
+	ASSERT_EQ(Schema::SEQUENCE, map.kind);
+	ASSERT_EQ(2u, map.fields.size());
+	ASSERT_STREQ("std::string", map.fields[0].raw);
+	ASSERT_STREQ("int", map.fields[1].raw);
+
+	Schema tuple = describe<Holder<std::tuple<int, std::string, double> > >().fields[0];
+	ASSERT_EQ(Schema::OBJECT, tuple.kind);
+	ASSERT_EQ(3u, tuple.fields.size());
+
+	Schema optional = describe<Holder<std::optional<int> > >().fields[0];
+	ASSERT_EQ(Schema::OPTIONAL, optional.kind);
+	ASSERT_EQ(1u, optional.fields.size());
+
+	Schema variant = describe<Holder<std::variant<int, std::string> > >().fields[0];
+	ASSERT_EQ(Schema::VARIANT, variant.kind);
+	ASSERT_EQ(2u, variant.fields.size());
+
+	ASSERT_NE(fingerprint<Holder<std::set<int> > >(), fingerprint<Holder<std::set<double> > >());
+	ASSERT_NE(fingerprint<Holder<std::deque<int> > >(), fingerprint<Holder<std::deque<short> > >());
+	ASSERT_NE((fingerprint<Holder<std::pair<int, int> > >()), (fingerprint<Holder<std::pair<int, double> > >()));
+	// Same layout in binary streams
+	ASSERT_EQ((fingerprint<Holder<std::unordered_map<int, int> > >()), (fingerprint<Holder<std::map<int, int> > >()));
+}
+
+TEST(Schema, FingerprintHandshake) {
+	Record<1> record, fast, slow;
+	record.id   = 5;
+	record.text = "Positional";
+
+	std::stringstream tagged_stream, positional_stream;
+	{
+		OutputBinarySerializer out(tagged_stream);
+		out.fingerprinted(record);
+	}
+	{
+		OutputBinarySerializer out(positional_stream);
+		out.accept(fingerprint<Record<1> >());
+		out.fingerprinted(record);
+	}
+	// No names and sizes in positional layout
+	ASSERT_LT(positional_stream.str().size(), tagged_stream.str().size());
+
+	InputBinarySerializer tagged_in(tagged_stream);
+	tagged_in.fingerprinted(slow);
+	InputBinarySerializer positional_in(positional_stream);
+	positional_in.fingerprinted(fast);
+
+	ASSERT_EQ(5, slow.id);
+	ASSERT_EQ("Positional", slow.text);
+	ASSERT_EQ(5, fast.id);
+	ASSERT_EQ("Positional", fast.text);
+}
+
+TEST(Schema, FingerprintMismatch) {
+	Record<1> record;
+	record.id = 5;
+	std::stringstream stream;
+	{
+		OutputBinarySerializer out(stream);
+		out.accept(fingerprint<Record<1> >());
+		out.fingerprinted(record);
+	}
+
+	// Positional layout of other schema isn't decoded
+	InputBinarySerializer in(stream);
+	Record<2> other;
+	other.id = 7;
+	ASSERT_FALSE(in.fingerprinted(other));
+	ASSERT_EQ(7, other.id);
+}
+
+TEST(Schema, FingerprintOfPolymorphic) {
+	// Derived types behind pointer aren't part of schema
+	ASSERT_EQ(0u, fingerprint<VersionedSample>());
+	ASSERT_EQ(0u, fingerprint<Holder<Superman*> >());
+	ASSERT_NE(0u, fingerprint<Holder<Record<1>*> >());
+
+	Holder<Superman*> holder, read;
+	holder.value = new Superman(7);
+	std::stringstream stream;
+	{
+		OutputBinarySerializer out(stream);
+		out.accept(fingerprint<Holder<Superman*> >());
+		out.fingerprinted(holder);
+	}
+	InputBinarySerializer in(stream);
+	ASSERT_TRUE(in.fingerprinted(read));
+	ASSERT_EQ("Clark Kent", read.value->name());
+	delete holder.value, delete read.value;
+}
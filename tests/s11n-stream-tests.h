@@ -3,6 +3,7 @@
 #include "s11n-tests.h"
 #include <bike/s11n.h>
 #include <bike/s11n-sbinary.h>
+#include <bike/s11n-sbinary-stl.h>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <fstream>
@@ -163,6 +164,180 @@ TEST(Snabix, Bench2) {
 	}
 }
 
+TEST(Snabix, Optional) {
+	std::string str;
+	StrWriter strout(str);
+	OutputBinaryStreaming out(&strout);
+
+	ConfigSample def;
+	out << def;
+	// Only presence bitmap for all default fields
+	ASSERT_EQ(2u, str.size());
+
+	ConfigSample custom;
+	custom.start_url = "http://github.com/";
+	int tail = 5;
+	out << custom << tail;
+
+	StrReader strin(str);
+	InputBinaryStreaming in(&strin);
+
+	ConfigSample def_read, custom_read;
+	def_read.name = "Not default";
+	int tail_read = 0;
+	in >> def_read >> custom_read >> tail_read;
+
+	ASSERT_EQ(def, def_read);
+	ASSERT_EQ(custom, custom_read);
+	ASSERT_EQ(tail, tail_read);
+}
+
+struct Shape {
+	int id;
+
+	Shape(int id = 0) : id(id) {}
+
+	virtual ~Shape() {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node & id;
+	}
+};
+
+struct Circle : public Shape {
+	int radius;
+
+	Circle(int id = 0, int radius = 0) : Shape(id), radius(radius) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.base<Shape>(this);
+		node & radius;
+	}
+};
+
+struct Scene {
+	std::shared_ptr<Shape> main;
+	std::shared_ptr<Shape> copy;
+	Shape*                 raw;
+
+	Scene() : raw(S11N_NULLPTR) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node & main & copy & raw;
+	}
+};
+
+TEST(Snabix, SharedPointers) {
+	std::string str;
+	StrWriter strout(str);
+	OutputBinaryStreaming out(&strout);
+
+	Scene scene;
+	scene.main.reset(new Circle(3, 14));
+	scene.copy = scene.main;
+	scene.raw  = scene.main.get();
+	out << scene;
+
+	// Registered type is written with number instead of name
+	ASSERT_EQ(std::string::npos, str.find(typeid(Circle).name()));
+
+	StrReader strin(str);
+	InputBinaryStreaming in(&strin);
+
+	Scene read;
+	in >> read;
+
+	ASSERT_TRUE(read.main.get() != S11N_NULLPTR);
+	ASSERT_EQ(read.main, read.copy);
+	ASSERT_EQ(read.main.get(), read.raw);
+	ASSERT_EQ(2, read.main.use_count());
+
+	Circle* circle = dynamic_cast<Circle*>(read.main.get());
+	ASSERT_NE((Circle*) S11N_NULLPTR, circle);
+	ASSERT_EQ(3,  circle->id);
+	ASSERT_EQ(14, circle->radius);
+}
+
+struct Containers {
+	std::deque<int>                       queue;
+	std::array<short, 3>                  triple;
+	std::map<std::string, Circle>         circles;
+	std::unordered_map<int, std::string>  names;
+	std::set<int>                         ids;
+	std::pair<int, std::string>           pair;
+	std::tuple<int, double, std::string>  tuple;
+	std::vector<double>                   samples;
+	std::vector<std::string>              words;
+#ifdef S11N_CPP17
+	std::optional<Circle>                 present;
+	std::optional<int>                    absent;
+	std::variant<int, std::string>        variant;
+#endif
+
+	template <class Node>
+	void ser(Node& node) {
+		node & queue & triple & circles & names & ids & pair & tuple & samples & words;
+#ifdef S11N_CPP17
+		node & present & absent & variant;
+#endif
+	}
+};
+
+TEST(Snabix, Containers) {
+	std::string str;
+	StrWriter strout(str);
+	OutputBinaryStreaming out(&strout);
+
+	Containers c;
+	c.queue.push_back(1);
+	c.queue.push_front(-1);
+	c.triple[0] = 1, c.triple[1] = -2, c.triple[2] = 3;
+	c.circles["first"]  = Circle(1, 10);
+	c.circles["second"] = Circle(2, 20);
+	c.names[7] = "seven";
+	c.names[8] = "eight";
+	c.ids.insert(5);
+	c.ids.insert(3);
+	c.pair  = std::make_pair(4, std::string("four"));
+	c.tuple = std::make_tuple(1, 0.5, std::string("half"));
+	for (int i = 0; i < 100; ++i)
+		c.samples.push_back(i * 0.25);
+	c.words.push_back("hello");
+	c.words.push_back("world");
+#ifdef S11N_CPP17
+	c.present = Circle(9, 90);
+	c.variant = std::string("alternative");
+#endif
+	out << c;
+
+	StrReader strin(str);
+	InputBinaryStreaming in(&strin);
+
+	Containers r;
+	r.ids.insert(100); // Must be cleared
+	in >> r;
+
+	ASSERT_EQ(c.queue,   r.queue);
+	ASSERT_EQ(c.triple,  r.triple);
+	ASSERT_EQ(2u,        r.circles.size());
+	ASSERT_EQ(20,        r.circles["second"].radius);
+	ASSERT_EQ(c.names,   r.names);
+	ASSERT_EQ(c.ids,     r.ids);
+	ASSERT_EQ(c.pair,    r.pair);
+	ASSERT_EQ(c.tuple,   r.tuple);
+	ASSERT_EQ(c.samples, r.samples);
+	ASSERT_EQ(c.words,   r.words);
+#ifdef S11N_CPP17
+	ASSERT_TRUE(r.present.has_value());
+	ASSERT_EQ(90, r.present->radius);
+	ASSERT_FALSE(r.absent.has_value());
+	ASSERT_EQ(c.variant, r.variant);
+#endif
+}
+
 TEST(Msb32, 0) {
 	ASSERT_EQ(32, msb32(0xFF000000));
 	ASSERT_EQ(24, msb32(0x00FF0000));
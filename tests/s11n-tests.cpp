@@ -12,19 +12,25 @@
 #include <bike/s11n.h>
 #include <bike/s11n-xml.h>
 #include <bike/s11n-xml-stl.h>
+#include <bike/s11n-binary.h>
 #include "s11n-base-tests.h"
 #include "s11n-stream-tests.h"
 #include "s11n-docs-tests.h"
+#include "s11n-schema-tests.h"
 
 #ifndef S11N_CPP03
 #	include "s11n-complex-tests.h"
+#	include "s11n-xml-tests.h"
 #endif
 
-Serializers<XmlSerializer> serializers;
+Serializers<XmlSerializer, BinarySerializer> serializers;
 
 GTEST_API_ int main(int argc, char **argv) {
 	serializers.reg<Human>();
 	serializers.reg<Superman>();
+	serializers.reg<Shape>();
+	serializers.reg<Circle>();
+	serializers.reg<X2>();
 
 	testing::InitGoogleTest(&argc, argv);
 	int code = RUN_ALL_TESTS();
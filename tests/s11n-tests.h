@@ -4,3 +4,13 @@
 #define S11N_USE_VECTOR
 #define S11N_USE_STRING
 #define S11N_USE_MEMORY
+#define S11N_USE_DEQUE
+#define S11N_USE_ARRAY
+#define S11N_USE_MAP
+#define S11N_USE_UNORDERED_MAP
+#define S11N_USE_SET
+#define S11N_USE_UTILITY
+#define S11N_USE_TUPLE
+#define S11N_USE_OPTIONAL
+#define S11N_USE_VARIANT
+#define S11N_USE_MMAP
@@ -1,77 +1,537 @@
+// s11n
+//
+#include "s11n-tests.h"
 #include <bike/s11n.h>
 #include <bike/s11n-xml.h>
+#include <bike/s11n-xml-stl.h>
 #include <gtest/gtest.h>
-#include <iostream>
+#include <cstdio>
 #include <fstream>
-#include <cmath>
-#include <limits>
+#include <memory>
+#include <sstream>
 
 using namespace bike;
 
-class XmlSerializer
-{
-public:
-	typedef InputXmlSerializer  Input;
-	typedef OutputXmlSerializer Output;
+TEST(Xml, TypeKeys) {
+	std::unique_ptr<Shape> circle(new Circle(1, 2)), read;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << circle;
+	ASSERT_EQ(std::string::npos, stream.str().find(typeid(Circle).name()));
+
+	InputXmlSerializer in(stream);
+	in >> read;
+	ASSERT_EQ(2, dynamic_cast<Circle&>(*read).radius);
+}
+
+TEST(Xml, VersionTable) {
+	X2 w(7, 9), w2(1, 2), r, r2;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w << w2;
+	const std::string xml = stream.str();
+	ASSERT_EQ(std::string::npos, xml.find("ver=\"0\""));
+	// Version of registered type is declared once per stream
+	ASSERT_NE(std::string::npos, xml.find("<versions>"));
+	ASSERT_EQ(xml.find("<versions>"), xml.rfind("<versions>"));
+	ASSERT_EQ(std::string::npos, xml.find("<object ver="));
+
+	InputXmlSerializer in(stream);
+	in >> r >> r2;
+	ASSERT_EQ(9, r.y);
+	ASSERT_EQ(2, r2.y);
+
+	// Unregistered types keep versions in objects instead of compiler specific names in table
+	std::stringstream messages;
+	OutputXmlSerializer messages_out(messages);
+	Message message(2), message1(1), message_read, message1_read;
+	message.y = 7, message1.y = 8;
+	messages_out << message << message1;
+	ASSERT_EQ(std::string::npos, messages.str().find(typeid(Message).name()));
+	ASSERT_EQ(std::string::npos, messages.str().find("<versions>"));
+	InputXmlSerializer messages_in(messages);
+	messages_in >> message_read >> message1_read;
+	ASSERT_EQ(7, message_read.y);
+	ASSERT_EQ(1u, message1_read.protocol.version());
+	ASSERT_EQ(0, message1_read.y);
+
+	// Format version 1 keeps versions in objects
+	std::stringstream legacy("<serializable fmtver=\"1\"><object ver=\"1\"><object value=\"3\" ver=\"0\" /><object value=\"4\" ver=\"0\" /></object></serializable>");
+	InputXmlSerializer legacy_in(legacy);
+	X2 legacy_read;
+	legacy_in >> legacy_read;
+	ASSERT_EQ(3, legacy_read.x);
+	ASSERT_EQ(4, legacy_read.y);
+}
+
+TEST(Xml, VersionCache) {
+	const std::string key = XmlVersionTable::key(typeid(Human));
+	ASSERT_FALSE(key.empty());
+	pugi::xml_document first, second;
+	first.load(("<r><versions><type key=\"" + key + "\" ver=\"2\" /></versions></r>").c_str());
+	second.load(("<r><versions><type key=\"" + key + "\" ver=\"5\" /></versions></r>").c_str());
+
+	// Cache of call site is shared by tables, but keeps result of one table only
+	XmlVersionCache cache;
+	XmlVersionTable a, b;
+	a.load(first.first_child());
+	ASSERT_EQ(2u, a.find(typeid(Human), cache));
+	ASSERT_EQ(0u, b.find(typeid(Human), cache));
+	b.load(second.first_child());
+	ASSERT_EQ(5u, b.find(typeid(Human), cache));
+	ASSERT_EQ(2u, a.find(typeid(Human), cache));
+}
+
+TEST(Xml, StreamingWriter) {
+	std::string text = "a<b & \"c\"\n", read_text;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << text;
+	ASSERT_EQ("<serializable fmtver=\"2\"><object value=\"a&lt;b &amp; &quot;c&quot;&#10;\" /></serializable>", stream.str());
+
+	// Records bigger than buffer are flushed in parts
+	std::vector<int> numbers(100000), read_numbers;
+	for (size_t i = 0; i < numbers.size(); ++i)
+		numbers[i] = int(i * 7);
+	out << numbers;
+
+	InputXmlSerializer in(stream);
+	in >> read_text >> read_numbers;
+	ASSERT_EQ(text, read_text);
+	ASSERT_EQ(numbers, read_numbers);
+}
+
+TEST(Xml, RecordReader) {
+	// Records are parsed one by one, so truncated tail doesn't break previous records
+	std::stringstream stream(
+		"<serializable fmtver=\"2\"><object value=\"a>b\" /></serializable>"
+		"<!-- <serializable> -->"
+		"<serializable fmtver=\"2\"><object value=\"5\" /></serializable>"
+		"<serializable fmtver=\"2\"><obj");
+	InputXmlSerializer in(stream);
+	std::string text;
+	int x = 0;
+	in >> text >> x;
+	ASSERT_EQ("a>b", text);
+	ASSERT_EQ(5, x);
+	ASSERT_FALSE(in.failed());
+	in >> x;
+	ASSERT_TRUE(in.failed());
+}
+
+TEST(Xml, RecordCap) {
+	std::stringstream stream;
+	{
+		OutputXmlSerializer out(stream);
+		std::string small = "small", large(1000, 'x');
+		out << small << large << small;
+	}
+	std::string data = stream.str();
+
+	// Reading stops at record larger than cap, buffer doesn't grow with it
+	std::stringstream input(data);
+	InputXmlSerializer in(input);
+	in.set_max_record(500);
+	std::string read;
+	in >> read;
+	ASSERT_EQ("small", read);
+	ASSERT_FALSE(in.failed());
+	in >> read;
+	ASSERT_TRUE(in.failed());
+	ASSERT_EQ("small", read);
+
+	InputXmlSerializer block(&data[0], data.size());
+	block.set_max_record(500);
+	block >> read >> read;
+	ASSERT_TRUE(block.failed());
+}
+
+TEST(Xml, RecordMode) {
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out.record_mode(true);
+	for (int i = 0; i < 3; ++i) {
+		std::unique_ptr<Shape> circle(new Circle(i, i + 1));
+		out << circle;
+		// Nothing is kept from previous records
+		ASSERT_EQ(0u, out.refs()->issued());
+	}
+
+	InputXmlSerializer in(stream);
+	for (int i = 0; i < 3; ++i) {
+		std::unique_ptr<Shape> read;
+		in >> read;
+		ASSERT_EQ(i + 1, dynamic_cast<Circle&>(*read).radius);
+		ASSERT_TRUE(in.refs()->get(2) == S11N_NULLPTR);
+	}
+}
+
+TEST(Xml, OptionalCursor) {
+	MixedOptional w, r;
+	w.a = 1, w.b = 2, w.c = 3, w.d = 0;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
+
+	// Positional field after optional one is read from its own element
+	InputXmlSerializer in(stream);
+	in >> r;
+	ASSERT_EQ(1, r.a);
+	ASSERT_EQ(2, r.b);
+	ASSERT_EQ(3, r.c);
+	ASSERT_EQ(0, r.d);
+}
+
+/// Reads fields of MixedOptional in other order and looks for absent one
+struct ReorderedOptional {
+	int a, b, c, d, e;
+
+	ReorderedOptional() : a(0), b(0), c(0), d(0), e(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node.optional(d, "d", -1);
+		node.optional(e, "e", -1);
+		node.optional(b, "b", -1);
+		node.optional(a, "a", -1);
+		node.optional(c, "c", -1);
+	}
 };
 
-class TextSerializer
-{
+TEST(Xml, OptionalIndex) {
+	MixedOptional w;
+	ReorderedOptional r;
+	w.a = 1, w.b = 2, w.c = 3, w.d = 4;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
+
+	InputXmlSerializer in(stream);
+	in >> r;
+	ASSERT_EQ(1, r.a);
+	ASSERT_EQ(2, r.b);
+	ASSERT_EQ(3, r.c);
+	ASSERT_EQ(4, r.d);
+	ASSERT_EQ(-1, r.e);
+}
+
+struct CountedId {
+	static int decoded; /// Calls of ser()
+
+	int value;
+
+	CountedId(int value = 0) : value(value) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node & value;
+		++decoded;
+	}
+};
+
+int CountedId::decoded = 0;
+
+class Account {
 public:
-	typedef InputTextSerializer  Input;
-	typedef OutputTextSerializer Output;
+	explicit Account(const CountedId& id) : id_(id) {}
+
+	int id() const { return id_.value; }
+
+	template <class Node>
+	void ser(Node& node) {
+		node.named(id_, "id");
+	}
+
+protected:
+	CountedId id_;
 };
 
-template <typename Serializer>
-class SimpleTest : public ::testing::Test {
+template <class Node>
+class Ctor<Account*, Node> {
 public:
-	typedef typename Serializer::Input  Input; 
-	typedef typename Serializer::Output Output; 
+	static Account* ctor(Node& node) {
+		CountedId id;
+		node.search(id, "id");
+		return new Account(id);
+	}
+};
+
+TEST(Xml, SearchedOnce) {
+	Account* w = new Account(CountedId(42)), *r = S11N_NULLPTR;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
 
-	void SetUp() /* override */	{
+	CountedId::decoded = 0;
+	InputXmlSerializer in(stream);
+	in >> r;
+	ASSERT_EQ(42, r->id());
+	// Field decoded by constructor isn't decoded by ser() again
+	ASSERT_EQ(1, CountedId::decoded);
+	delete w, delete r;
+}
+
+/// Constructor searches field by name in buffer, which is changed before ser()
+class BufferAccount : public Account {
+public:
+	explicit BufferAccount(const CountedId& id) : Account(id) {}
+};
 
+template <class Node>
+class Ctor<BufferAccount*, Node> {
+public:
+	static BufferAccount* ctor(Node& node) {
+		CountedId id;
+		char name[8];
+		std::strcpy(name, "id");
+		node.search(id, name);
+		std::strcpy(name, "xx");
+		return new BufferAccount(id);
 	}
- 
-	void TearDown() /* override */ {
+};
 
+TEST(Xml, SearchedName) {
+	BufferAccount* w = new BufferAccount(CountedId(43)), *r = S11N_NULLPTR;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
+
+	CountedId::decoded = 0;
+	InputXmlSerializer in(stream);
+	in >> r;
+	ASSERT_EQ(43, r->id());
+	ASSERT_EQ(1, CountedId::decoded);
+	delete w, delete r;
+}
+
+struct Labeled {
+	CountedId   id;
+	std::string label;
+	int         n;
+
+	Labeled() : n(0) {}
+
+	template <class Node>
+	void ser(Node& node) {
+		node & id;
+		node.named(label, "label");
+		node.named(n, "n");
 	}
+};
 
-	template <typename T>
-	void test_val(const T& write)
+TEST(Xml, Compact) {
+	MixedOptional w, r;
+	w.a = 1, w.b = 2, w.c = 3, w.d = 0;
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out.compact(true);
+	out << w;
+	// Field "c" clashes with concept attribute, so it stays element
+	ASSERT_EQ("<serializable fmtver=\"3\"><o a=\"1\" b=\"2\"><o n=\"c\" v=\"3\" /></o></serializable>", stream.str());
+
+	// Fields after child objects stay elements too
+	Labeled labeled, labeled_read;
+	labeled.id.value = 5, labeled.label = "five", labeled.n = 6;
+	std::unique_ptr<Shape> circle(new Circle(1, 2)), circle_read;
+	out << labeled << circle;
+
+	InputXmlSerializer in(stream);
+	in >> r >> labeled_read >> circle_read;
+	ASSERT_EQ(1, r.a);
+	ASSERT_EQ(2, r.b);
+	ASSERT_EQ(3, r.c);
+	ASSERT_EQ(0, r.d);
+	ASSERT_EQ(5, labeled_read.id.value);
+	ASSERT_EQ("five", labeled_read.label);
+	ASSERT_EQ(6, labeled_read.n);
+	ASSERT_EQ(2, dynamic_cast<Circle&>(*circle_read).radius);
+}
+
+TEST(Xml, WriterAttributes) {
+	std::stringstream stream;
+	XmlWriter writer(&stream);
+	writer.start("o");
+	writer.attribute("xa", 1);
+	writer.attribute("b", " a=\"");
+	ASSERT_FALSE(writer.has_attribute("a"));
+	ASSERT_FALSE(writer.has_attribute("o"));
+	ASSERT_TRUE(writer.has_attribute("xa"));
+	ASSERT_TRUE(writer.has_attribute("b"));
+	writer.start("o");
+	ASSERT_FALSE(writer.has_attribute("b"));
+	writer.end();
+	writer.end();
+	writer.flush();
+	ASSERT_EQ("<o xa=\"1\" b=\" a=&quot;\"><o /></o>", stream.str());
+}
+
+TEST(Xml, InPlace) {
+	Labeled w, r;
+	w.id.value = 7, w.label = "a & b", w.n = 8;
+	int x = 9, read_x = 0;
+	{
+		std::ofstream fout("inplace.xml", std::ios::binary);
+		OutputXmlSerializer out(fout);
+		out << w << x;
+	}
+	std::stringstream written;
+	written << std::ifstream("inplace.xml", std::ios::binary).rdbuf();
 	{
-		fout_.open("test.txt");
-		out_.reset(new Output(fout_));
-		*out_ << write;
-		fout_.close();
+		InputXmlSerializer in("inplace.xml");
+		in >> r >> read_x;
+	}
+	ASSERT_EQ(7, r.id.value);
+	ASSERT_EQ("a & b", r.label);
+	ASSERT_EQ(9, read_x);
+
+	// File isn't changed by parsing in place
+	std::stringstream after;
+	after << std::ifstream("inplace.xml", std::ios::binary).rdbuf();
+	ASSERT_EQ(written.str(), after.str());
 
-		fin_.open("test.txt");
-		T read;
-		in_.reset(new Input(fin_));
-		*in_ >> read;
+	// File read to owned buffer, when it isn't mapped
+	{
+		XmlFileBlock mapped("inplace.xml"), read("inplace.xml", false);
+#ifdef S11N_USE_MMAP
+		ASSERT_TRUE(mapped.mapped());
+#endif
+		ASSERT_FALSE(read.mapped());
+		ASSERT_EQ(written.str(), std::string(read.data(), read.size()));
 
-		ASSERT_EQ(read, write);
+		Labeled r1;
+		read_x = 0;
+		InputXmlSerializer in("inplace.xml", false);
+		in >> r1 >> read_x;
+		ASSERT_EQ("a & b", r1.label);
+		ASSERT_EQ(9, read_x);
 	}
+	ASSERT_EQ(0, std::remove("inplace.xml"));
 
-public:
-	std::unique_ptr<Input> in_;
-	std::ifstream fin_;
+	std::string text = written.str();
+	std::vector<char> block(text.begin(), text.end());
+	Labeled r2;
+	InputXmlSerializer in(&block[0], block.size());
+	in >> r2;
+	ASSERT_EQ("a & b", r2.label);
+}
+
+struct Numbers {
+	double d[4];
+	float  f[3];
+	int    i[3];
 
-	std::unique_ptr<Output> out_;
-	std::ofstream fout_;
+	template <class Node>
+	void ser(Node& node) {
+		for (int k = 0; k < 4; ++k)
+			node & d[k];
+		for (int k = 0; k < 3; ++k)
+			node & f[k];
+		for (int k = 0; k < 3; ++k)
+			node & i[k];
+	}
 };
 
-TYPED_TEST_CASE_P(SimpleTest);
+TEST(Xml, Numbers) {
+	Numbers w = { { 0.1, 1. / 3., -1e-310, 123456789.123456789 }, { 0.1f, 1.f / 3.f, -3.4e38f }, { 0, -2147483647 - 1, 2147483647 } };
+	Numbers r = {};
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
+	InputXmlSerializer in(stream);
+	in >> r;
+	// Numbers are read back exactly
+	ASSERT_EQ(0, std::memcmp(&w, &r, sizeof(Numbers)));
+
+	char buf[XmlNumber::SIZE];
+	ASSERT_EQ("-42", std::string(buf, XmlNumber::format(buf, -42)));
+	ASSERT_EQ(0.5, XmlNumber::as_double("0.5"));
+	ASSERT_EQ(0, XmlNumber::as_int(""));
+	// Hex, spaces and signs like in pugixml
+	ASSERT_EQ(31, XmlNumber::as_int("0x1F"));
+	ASSERT_EQ(-16, XmlNumber::as_int(" -0x10"));
+	ASSERT_EQ(0xFFFFFFFFu, XmlNumber::as_uint("0xffffffff"));
+	ASSERT_EQ(10u, XmlNumber::as_uint("+10"));
+	ASSERT_EQ(10, XmlNumber::as_int("010"));
+}
+
+TEST(Xml, PackedVectors) {
+	std::vector<int> ints, read_ints;
+	for (int i = -500; i < 500; ++i)
+		ints.push_back(i * 4099);
+	std::vector<double> doubles(3, 0.1), read_doubles;
+	std::vector<unsigned char> bytes(4, 0xFF), read_bytes;
+	std::vector<short> empty, read_empty(2);
+
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out.packed(true);
+	out << ints << doubles << bytes << empty;
+	ASSERT_NE(std::string::npos, stream.str().find("concept=\"B64\" value=\"/////w==\""));
 
-TYPED_TEST_P(SimpleTest, Integer) {
-	int x = 5;
-	test_val(x);
+	InputXmlSerializer in(stream);
+	in >> read_ints >> read_doubles >> read_bytes >> read_empty;
+	ASSERT_EQ(ints, read_ints);
+	ASSERT_EQ(doubles, read_doubles);
+	ASSERT_EQ(bytes, read_bytes);
+	ASSERT_TRUE(read_empty.empty());
+
+	// Every length of tail is decoded
+	for (size_t size = 0; size < 8; ++size) {
+		unsigned char data[8] = { 1, 2, 3, 250, 251, 252, 253, 254 }, decoded[8] = {};
+		char encoded[16];
+		XmlBase64::encode(data, size, encoded);
+		const size_t length = XmlBase64::encoded_size(size);
+		ASSERT_EQ(size, XmlBase64::decoded_size(encoded, length));
+		ASSERT_TRUE(XmlBase64::decode(encoded, length, decoded));
+		ASSERT_EQ(0, std::memcmp(data, decoded, size));
+	}
 }
 
-TYPED_TEST_P(SimpleTest, Vector2) {
-	Vec2 vec(10, 13);
-	test_val(vec);
+TEST(Xml, SequenceInPlace) {
+	std::vector<Payload> w(100), r(3);
+	for (size_t i = 0; i < w.size(); ++i)
+		w[i].data.assign(i % 7, int(i));
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
+
+	Payload::copies = 0;
+	InputXmlSerializer in(stream);
+	in >> r;
+	ASSERT_EQ(0, Payload::copies);
+	ASSERT_EQ(w.size(), r.capacity());
+	ASSERT_EQ(w.size(), r.size());
+	for (size_t i = 0; i < w.size(); ++i)
+		ASSERT_EQ(w[i].data, r[i].data);
 }
-REGISTER_TYPED_TEST_CASE_P(SimpleTest, Integer, Vector2);
 
-typedef ::testing::Types<XmlSerializer, TextSerializer> TestSerializers;
-INSTANTIATE_TYPED_TEST_CASE_P(Test, SimpleTest, TestSerializers);
+TEST(Xml, VectorOfBool) {
+	std::vector<bool> w, r(2, true);
+	for (int i = 0; i < 10; ++i)
+		w.push_back(i % 3 == 0);
+	std::stringstream stream;
+	OutputXmlSerializer out(stream);
+	out << w;
+
+	InputXmlSerializer in(stream);
+	in >> r;
+	ASSERT_EQ(w, r);
+}
+
+TEST(Xml, PackedCorrupted) {
+	unsigned char decoded[8];
+	// Padding out of last group and data after padding
+	ASSERT_FALSE(XmlBase64::decode("AA==AAAA", 8, decoded));
+	ASSERT_FALSE(XmlBase64::decode("AA=A", 4, decoded));
+	ASSERT_FALSE(XmlBase64::decode("AA*A", 4, decoded));
+	ASSERT_TRUE(XmlBase64::decode("AA==", 4, decoded));
+
+	std::vector<int> kept(2, 7);
+	// 6 bytes aren't whole ints
+	ASSERT_FALSE(XmlVector<true>::unpack("AAAAAAAA", kept));
+	ASSERT_FALSE(XmlVector<true>::unpack("AAAAA", kept));
+	ASSERT_FALSE(XmlVector<true>::unpack("AAAA=AAA", kept));
+	ASSERT_EQ(std::vector<int>(2, 7), kept);
+	ASSERT_TRUE(XmlVector<true>::unpack("AQAAAA==", kept));
+	ASSERT_EQ(std::vector<int>(1, 1), kept);
+}